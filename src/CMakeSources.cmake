@@ -1,39 +1,59 @@
 set(GGPO_LIB_INC_NOFILTER
 	"lib/ggpo/bitvector.h"
+	"lib/ggpo/bytemask.h"
+	"lib/ggpo/checksum.h"
+	"lib/ggpo/config.h"
+	"lib/ggpo/delta.h"
 	"lib/ggpo/game_input.h"
+	"lib/ggpo/input_predictor.h"
 	"lib/ggpo/input_queue.h"
 	"lib/ggpo/log.h"
+	"lib/ggpo/page_snapshot.h"
 	"lib/ggpo/poll.h"
 	"lib/ggpo/ring_buffer.h"
+	"lib/ggpo/snapshot_worker.h"
+	"lib/ggpo/spsc_ring.h"
 	"lib/ggpo/sync.h"
 	"lib/ggpo/timesync.h"
+	"lib/ggpo/trace.h"
 	"lib/ggpo/types.h"
+	"lib/ggpo/varint.h"
 	"lib/ggpo/zconf.h"
 	"lib/ggpo/zlib.h"
 )
 
 set(GGPO_LIB_SRC_NOFILTER
 	"lib/ggpo/bitvector.cpp"
+	"lib/ggpo/bytemask.cpp"
+	"lib/ggpo/checksum.cpp"
+	"lib/ggpo/config.cpp"
+	"lib/ggpo/delta.cpp"
 	"lib/ggpo/game_input.cpp"
+	"lib/ggpo/input_predictor.cpp"
 	"lib/ggpo/input_queue.cpp"
 	"lib/ggpo/log.cpp"
 	"lib/ggpo/main.cpp"
 	"lib/ggpo/poll.cpp"
 	"lib/ggpo/sync.cpp"
 	"lib/ggpo/timesync.cpp"
+	"lib/ggpo/trace.cpp"
 )
 
 if(UNIX)
 	set(GGPO_LIB_SRC_NOFILTER
 		${GGPO_LIB_SRC_NOFILTER}
+		"lib/ggpo/page_snapshot_linux.cpp"
 		"lib/ggpo/platform_linux.cpp"
+		"lib/ggpo/snapshot_worker_linux.cpp"
 	)
 endif()
 
 if(WIN32)
 	set(GGPO_LIB_SRC_NOFILTER
 		${GGPO_LIB_SRC_NOFILTER}
+		"lib/ggpo/page_snapshot_windows.cpp"
 		"lib/ggpo/platform_windows.cpp"
+		"lib/ggpo/snapshot_worker_windows.cpp"
 	)
 endif()
 
@@ -41,8 +61,10 @@ set(GGPO_LIB_INC_NETWORK
 	"lib/ggpo/network/udp.h"
 	"lib/ggpo/network/udp_msg.h"
 	"lib/ggpo/network/udp_proto.h"
+    "lib/ggpo/network/receive_thread.h"
     "lib/ggpo/network/steam.h"
     "lib/ggpo/network/steam_msg.h"
+    "lib/ggpo/network/steam_msg_pool.h"
     "lib/ggpo/network/steam_proto.h"
 )
 
@@ -53,6 +75,20 @@ set(GGPO_LIB_SRC_NETWORK
     "lib/ggpo/network/steam_proto.cpp"
 )
 
+if(UNIX)
+	set(GGPO_LIB_SRC_NETWORK
+		${GGPO_LIB_SRC_NETWORK}
+		"lib/ggpo/network/receive_thread_linux.cpp"
+	)
+endif()
+
+if(WIN32)
+	set(GGPO_LIB_SRC_NETWORK
+		${GGPO_LIB_SRC_NETWORK}
+		"lib/ggpo/network/receive_thread_windows.cpp"
+	)
+endif()
+
 set(GGPO_LIB_INC_BACKENDS
 	"lib/ggpo/backends/backend.h"
 	"lib/ggpo/backends/p2p.h"
@@ -0,0 +1,9 @@
+set(GGPO_APPS_GGPOTRACE_SRC_NOFILTER
+	"ggpotrace.cpp"
+)
+
+source_group(" " FILES ${GGPO_APPS_GGPOTRACE_SRC_NOFILTER})
+
+set(GGPO_APPS_GGPOTRACE_SRC
+	${GGPO_APPS_GGPOTRACE_SRC_NOFILTER}
+)
@@ -0,0 +1,223 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+/*
+ * ggpotrace - turns the trace-<pid>.bin file written by a session run with
+ * ggpo.log.trace into text, merging every thread's records by time.
+ *
+ *    ggpotrace trace-1234.bin > trace-1234.log
+ */
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+#include "trace.h"
+
+struct Entry {
+   int               thread;
+   TraceRecord       record;
+};
+
+static bool
+EntryBefore(const Entry &a, const Entry &b)
+{
+   /*
+    * Times are 32-bit microseconds, so this only orders traces shorter
+    * than half an hour or so correctly.
+    */
+   return (int)(a.record.time - b.record.time) < 0;
+}
+
+static bool
+ReadFile(const char *filename, std::vector<char> &data)
+{
+   FILE *fp = fopen(filename, "rb");
+   char buf[4096];
+   size_t n;
+
+   if (!fp) {
+      return false;
+   }
+   while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) {
+      data.insert(data.end(), buf, buf + n);
+   }
+   fclose(fp);
+   return true;
+}
+
+/*
+ * Prints the text between conversions, where "%%" means "%".
+ */
+static void
+PrintText(FILE *out, const char *text, const char *end)
+{
+   while (text < end) {
+      fputc(*text, out);
+      text += (text[0] == '%' && text[1] == '%') ? 2 : 1;
+   }
+}
+
+/*
+ * Prints fmt with the arguments saved in record, one conversion at a
+ * time.  Arguments which didn't fit in the record print as "?".
+ */
+static void
+PrintMessage(FILE *out, const char *fmt, const TraceRecord *record)
+{
+   const ggpo::byte *p = record->args;
+   const ggpo::byte *limit = record->args + sizeof(record->args);
+   const char *spec, *end;
+   char conversion[32];
+   int arg = 0;
+
+   for (;;) {
+      TraceArg type = TraceNextArg(fmt, &spec, &end);
+      PrintText(out, fmt, spec);
+      if (type == TRACE_ARG_NONE) {
+         break;
+      }
+      if (type == TRACE_ARG_UNSUPPORTED) {
+         PrintText(out, spec, spec + strlen(spec));
+         break;
+      }
+      fmt = end;
+
+      size_t len = MIN((size_t)(end - spec), sizeof(conversion) - 1);
+      memcpy(conversion, spec, len);
+      conversion[len] = '\0';
+
+      if (arg++ >= record->nargs || p >= limit) {
+         fputs("?", out);
+         continue;
+      }
+      if (type == TRACE_ARG_STRING) {
+         if (limit - p - 1 < *p) {
+            fputs("?", out);
+            p = limit;
+            continue;
+         }
+         std::string s((const char *)p + 1, *p);
+         fprintf(out, conversion, s.c_str());
+         p += 1 + *p;
+         continue;
+      }
+
+      ggpo::uint64 value;
+      if (limit - p < (int)sizeof(value)) {
+         fputs("?", out);
+         continue;
+      }
+      memcpy(&value, p, sizeof(value));
+      p += sizeof(value);
+
+      switch (type) {
+      case TRACE_ARG_INT:
+         fprintf(out, conversion, (int)value);
+         break;
+      case TRACE_ARG_INT64:
+         fprintf(out, conversion, (long long)value);
+         break;
+      case TRACE_ARG_DOUBLE: {
+         double d;
+         memcpy(&d, &value, sizeof(d));
+         fprintf(out, conversion, d);
+         break;
+      }
+      default:
+         fprintf(out, conversion, (void *)(size_t)value);
+         break;
+      }
+   }
+}
+
+int
+main(int argc, char *argv[])
+{
+   std::vector<char> data;
+
+   if (argc != 2) {
+      fprintf(stderr, "usage: %s trace-<pid>.bin\n", argv[0]);
+      return 1;
+   }
+   if (!ReadFile(argv[1], data)) {
+      fprintf(stderr, "%s: can't read %s.\n", argv[0], argv[1]);
+      return 1;
+   }
+
+   const char *p = data.empty() ? NULL : &data[0];
+   const char *limit = p + data.size();
+   TraceFileHeader header;
+
+   if (limit - p < (int)sizeof(header)) {
+      fprintf(stderr, "%s: %s is too short.\n", argv[0], argv[1]);
+      return 1;
+   }
+   memcpy(&header, p, sizeof(header));
+   p += sizeof(header);
+   if (header.magic != TRACE_FILE_MAGIC || header.version != TRACE_FILE_VERSION || header.record_size != sizeof(TraceRecord)) {
+      fprintf(stderr, "%s: %s isn't a trace from this version of ggpo.\n", argv[0], argv[1]);
+      return 1;
+   }
+
+   std::map<ggpo::uint64, std::string> strings;
+   for (ggpo::uint32 i = 0; i < header.num_strings; i++) {
+      ggpo::uint64 address;
+      ggpo::uint32 len;
+      if (limit - p < (int)(sizeof(address) + sizeof(len))) {
+         break;
+      }
+      memcpy(&address, p, sizeof(address));
+      memcpy(&len, p + sizeof(address), sizeof(len));
+      p += sizeof(address) + sizeof(len);
+      if ((ggpo::uint32)(limit - p) < len) {
+         break;
+      }
+      strings[address] = std::string(p, len);
+      p += len;
+   }
+
+   std::vector<Entry> entries;
+   for (ggpo::uint32 i = 0; i < header.num_rings; i++) {
+      ggpo::uint32 thread, count;
+      if (limit - p < (int)(sizeof(thread) + sizeof(count))) {
+         break;
+      }
+      memcpy(&thread, p, sizeof(thread));
+      memcpy(&count, p + sizeof(thread), sizeof(count));
+      p += sizeof(thread) + sizeof(count);
+      for (ggpo::uint32 j = 0; j < count && limit - p >= (int)sizeof(TraceRecord); j++) {
+         Entry entry;
+         entry.thread = (int)thread;
+         memcpy(&entry.record, p, sizeof(entry.record));
+         entries.push_back(entry);
+         p += sizeof(TraceRecord);
+      }
+   }
+   if (entries.empty()) {
+      return 0;
+   }
+
+   std::stable_sort(entries.begin(), entries.end(), EntryBefore);
+
+   ggpo::uint32 start = entries[0].record.time;
+   for (size_t i = 0; i < entries.size(); i++) {
+      const TraceRecord *record = &entries[i].record;
+      ggpo::uint32 t = record->time - start;
+
+      printf("%u.%06u t%d : ", t / 1000000, t % 1000000, entries[i].thread);
+      if (record->prefix && strings.count(record->prefix)) {
+         printf(strings[record->prefix].c_str(), record->id);
+      }
+      if (strings.count(record->fmt)) {
+         PrintMessage(stdout, strings[record->fmt].c_str(), record);
+      } else {
+         printf("(unknown format %llx)\n", record->fmt);
+      }
+   }
+   return 0;
+}
@@ -15,34 +15,6 @@ NonGameState ngs = { 0 };
 Renderer *renderer = NULL;
 GGPOSession *ggpo = NULL;
 
-/* 
- * Simple checksum function stolen from wikipedia:
- *
- *   http://en.wikipedia.org/wiki/Fletcher%27s_checksum
- */
-
-int
-fletcher32_checksum(short *data, size_t len)
-{
-   int sum1 = 0xffff, sum2 = 0xffff;
-
-   while (len) {
-      size_t tlen = len > 360 ? 360 : len;
-      len -= tlen;
-      do {
-         sum1 += *data++;
-         sum2 += sum1;
-      } while (--tlen);
-      sum1 = (sum1 & 0xffff) + (sum1 >> 16);
-      sum2 = (sum2 & 0xffff) + (sum2 >> 16);
-   }
-
-   /* Second reduction step to reduce sums to 16 bits */
-   sum1 = (sum1 & 0xffff) + (sum1 >> 16);
-   sum2 = (sum2 & 0xffff) + (sum2 >> 16);
-   return sum2 << 16 | sum1;
-}
-
 /*
  * vw_begin_game_callback --
  *
@@ -145,7 +117,25 @@ vw_save_game_state_callback(unsigned char **buffer, int *len, int *checksum, int
       return false;
    }
    memcpy(*buffer, &gs, *len);
-   *checksum = fletcher32_checksum((short *)*buffer, *len / 2);
+   *checksum = 0;    /* let ggpo compute it */
+   return true;
+}
+
+/*
+ * vw_save_game_state_into_callback --
+ *
+ * Save the current state into a buffer owned by GGPO.  Used instead of
+ * vw_save_game_state_callback once the snapshot arena has been set up.
+ */
+bool __cdecl
+vw_save_game_state_into_callback(unsigned char *buffer, int capacity, int *len, int *checksum, int)
+{
+   if (capacity < (int)sizeof(gs)) {
+      return false;
+   }
+   *len = sizeof(gs);
+   memcpy(buffer, &gs, *len);
+   *checksum = 0;
    return true;
 }
 
@@ -224,6 +214,7 @@ VectorWar_Init(HWND hwnd, unsigned short localport, int num_players, GGPOPlayer
    cb.free_buffer     = vw_free_buffer;
    cb.on_event        = vw_on_event_callback;
    cb.log_game_state  = vw_log_game_state;
+   cb.save_game_state_into = vw_save_game_state_into_callback;
 
 #if defined(SYNC_TEST)
    result = ggpo_start_synctest(&ggpo, &cb, "vectorwar", num_players, sizeof(int), 1);
@@ -231,6 +222,10 @@ VectorWar_Init(HWND hwnd, unsigned short localport, int num_players, GGPOPlayer
    result = ggpo_start_session(&ggpo, &cb, "vectorwar", num_players, sizeof(int), localport);
 #endif
 
+   // keep all our save states in a buffer owned by ggpo so saving and loading
+   // never has to allocate.
+   ggpo_set_snapshot_arena(ggpo, sizeof(gs));
+
    // automatically disconnect clients after 3000 ms and start our count-down timer
    // for disconnects after 1000 ms.   To completely disable disconnects, simply use
    // a value of 0 for ggpo_set_disconnect_timeout.
@@ -338,7 +333,7 @@ void VectorWar_AdvanceFrame(int inputs[], int disconnect_flags)
    // update the checksums to display in the top of the window.  this
    // helps to detect desyncs.
    ngs.now.framenumber = gs._framenumber;
-   ngs.now.checksum = fletcher32_checksum((short *)&gs, sizeof(gs) / 2);
+   ngs.now.checksum = ggpo_checksum(&gs, sizeof(gs));
    if ((gs._framenumber % 90) == 0) {
       ngs.periodic = ngs.now;
    }
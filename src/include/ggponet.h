@@ -36,7 +36,9 @@ extern "C" {
 #endif
 
 #define GGPO_MAX_PLAYERS                  4
-#define GGPO_MAX_PREDICTION_FRAMES        8
+#define GGPO_MAX_PREDICTION_FRAMES       30
+#define GGPO_DEFAULT_PREDICTION_FRAMES    8
+#define GGPO_MAX_SPECULATIVE_BRANCHES     8
 #define GGPO_MAX_SPECTATORS              32
 
 #define GGPO_SPECTATOR_INPUT_INTERVAL     4
@@ -214,7 +216,8 @@ typedef struct {
     * save_game_state - The client should allocate a buffer, copy the
     * entire contents of the current game state into it, and copy the
     * length into the *len parameter.  Optionally, the client can compute
-    * a checksum of the data and store it in the *checksum argument.
+    * a checksum of the data and store it in the *checksum argument.  If
+    * *checksum is left at 0, GGPO.net computes one with ggpo_checksum.
     */
    bool (__cdecl *save_game_state)(unsigned char **buffer, int *len, int *checksum, int frame);
 
@@ -256,6 +259,28 @@ typedef struct {
     * structure above for more information.
     */
    bool (__cdecl *on_event)(GGPOEvent *info);
+
+   /*
+    * save_game_state_into - Optional.  Only used once a snapshot arena has
+    * been created with ggpo_set_snapshot_arena, in which case it is called
+    * instead of save_game_state.  The client should copy the entire contents
+    * of the current game state into buffer, which is capacity bytes long,
+    * and store the number of bytes written in the *len parameter.  The buffer
+    * is owned by GGPO.net, so free_buffer is never called for it.  The
+    * *checksum parameter works the same as in save_game_state.
+    */
+   bool (__cdecl *save_game_state_into)(unsigned char *buffer, int capacity, int *len, int *checksum, int frame);
+
+   /*
+    * advance_state - Optional.  Only used once speculation has been turned
+    * on with ggpo_set_speculation.  The client should advance the game
+    * state saved in buffer (as written by save_game_state_into) by exactly
+    * one frame, in place, using the inputs and disconnect_flags exactly as
+    * ggpo_synchronize_input would have returned them.  Called from worker
+    * threads, several at a time, so it must not touch anything but buffer:
+    * no globals, no ggpo_log, and no calls back into GGPO.net.
+    */
+   bool (__cdecl *advance_state)(unsigned char *buffer, int len, void *inputs, int size, int disconnect_flags);
 } GGPOSessionCallbacks;
 
 /*
@@ -298,6 +323,7 @@ typedef struct GGPONetworkStats {
       int   recv_queue_len;
       int   ping;
       int   kbps_sent;
+      int   send_heap_allocs;   /* messages sent from the heap because the send queue was full */
    } network;
    struct {
       int   local_frames_behind;
@@ -305,6 +331,148 @@ typedef struct GGPONetworkStats {
    } timesync;
 } GGPONetworkStats;
 
+/*
+ * The GGPOSnapshotMode enumeration selects how GGPO.net stores the game
+ * states returned by save_game_state while they might still be needed for
+ * a rollback.
+ *
+ * GGPO_SNAPSHOT_FULL - Keep a complete copy of every saved state.  This is
+ * the default.
+ *
+ * GGPO_SNAPSHOT_DELTA - Keep a complete copy of the most recent state only.
+ * Older states are stored as the XOR of themselves and the state saved
+ * after them, run-length encoded.  This uses much less memory when most
+ * of the game state does not change from frame to frame, at the cost of
+ * having to walk the deltas back when loading an older state.
+ *
+ * GGPO_SNAPSHOT_PAGES - Save the region of memory registered with
+ * ggpo_set_snapshot_region directly, copying only the memory pages which
+ * were written since the last save.  Selected automatically by
+ * ggpo_set_snapshot_region.
+ */
+typedef enum {
+   GGPO_SNAPSHOT_FULL                  = 0,
+   GGPO_SNAPSHOT_DELTA                 = 1,
+   GGPO_SNAPSHOT_PAGES                 = 2,
+} GGPOSnapshotMode;
+
+/*
+ * The GGPOSnapshotStats structure counts the work done saving and loading
+ * game states since the session started.
+ *
+ * frames_saved, frames_loaded - The number of save_game_state and
+ * load_game_state calls made.
+ *
+ * bytes_saved - The number of bytes written to GGPO.net's saved states.
+ * For GGPO_SNAPSHOT_FULL this is the full size of every state saved.  For
+ * GGPO_SNAPSHOT_DELTA it is the size of the deltas, and for
+ * GGPO_SNAPSHOT_PAGES the size of the pages copied.
+ *
+ * bytes_loaded - The number of bytes read back out of the saved states to
+ * restore a game state, including any deltas which had to be applied.
+ *
+ * rollbacks_coalesced - With ggpo_set_rollback_coalescing enabled, the
+ * number of rollbacks which were avoided by folding them into one that
+ * was already waiting to run.
+ *
+ * rollbacks_spread - With ggpo_set_rollback_budget set, the number of
+ * rollbacks which ran out of time and had to finish on later frames.
+ *
+ * speculative_hits, speculative_misses - With ggpo_set_speculation on,
+ * the number of rollbacks which were handled by swapping in a speculative
+ * branch, and the number where branches had been run but none of them
+ * guessed right.
+ */
+typedef struct GGPOSnapshotStats {
+   int      frames_saved;
+   int      frames_loaded;
+   int      rollbacks_coalesced;
+   int      rollbacks_spread;
+   int      speculative_hits;
+   int      speculative_misses;
+   uint64   bytes_saved;
+   uint64   bytes_loaded;
+} GGPOSnapshotStats;
+
+/*
+ * The GGPOInputPredictor enumeration selects how GGPO.net guesses the
+ * input of remote players for frames it hasn't received yet.
+ *
+ * GGPO_PREDICT_REPEAT - The player does the same thing they did on the
+ * last frame received.  This is the default.
+ *
+ * GGPO_PREDICT_HOLD - Learns, for each input bit, how likely it is to
+ * stay the same from one frame to the next, and flips the bits which
+ * usually change.  Helps with buttons which are mashed and with analog
+ * inputs which dither between two values.
+ *
+ * GGPO_PREDICT_HISTORY - Remembers which input followed each pair of
+ * inputs seen recently, and predicts it will follow them again.  Helps
+ * with repetitive sequences like combos.
+ */
+typedef enum {
+   GGPO_PREDICT_REPEAT                 = 0,
+   GGPO_PREDICT_HOLD                   = 1,
+   GGPO_PREDICT_HISTORY                = 2,
+} GGPOInputPredictor;
+
+#define GGPO_NUM_INPUT_PREDICTORS      3
+
+/*
+ * The GGPOPredictionStats structure counts how well the input of one
+ * player has been predicted since the session started.  The arrays are
+ * indexed by GGPOInputPredictor.  Only the entries for the predictor
+ * selected with ggpo_set_input_predictor are filled in, unless
+ * ggpo_set_predictor_comparison has every predictor run alongside it so
+ * they can be compared on the same input.
+ *
+ * frames_predicted - The number of frames the game was run on a guess
+ * for this player and for which the real input has since arrived.
+ *
+ * frames_correct - How many of those each predictor guessed right.
+ *
+ * rollbacks, rollback_frames - The number of rollbacks each predictor's
+ * mistakes would have caused, and the total number of frames they would
+ * have re-run.  For the other predictors these are estimates, since the
+ * real rollbacks reset every predictor.
+ */
+typedef struct GGPOPredictionStats {
+   int      frames_predicted;
+   int      frames_correct[GGPO_NUM_INPUT_PREDICTORS];
+   int      rollbacks[GGPO_NUM_INPUT_PREDICTORS];
+   int      rollback_frames[GGPO_NUM_INPUT_PREDICTORS];
+} GGPOPredictionStats;
+
+#define GGPO_MAX_INPUT_BITS            256
+
+/*
+ * The GGPOMispredictionStats structure breaks down the mispredictions of
+ * one player's input which caused rollbacks since the session started.
+ * Only the first wrong frame of each rollback is counted.
+ *
+ * mispredictions - The number of mispredictions.
+ *
+ * bits - For each bit of the player's input, the number of mispredictions
+ * in which that bit was wrong.  Bits past the size of the input, or past
+ * GGPO_MAX_INPUT_BITS, are not counted.
+ *
+ * frames_ahead - frames_ahead[n] is the number of mispredictions made
+ * n + 1 frames past the last input received from the player.  Larger
+ * distances are counted in the last entry.
+ *
+ * rollback_depth - rollback_depth[n] is the number of mispredictions
+ * which meant re-running n + 1 frames, counted from the saved frame the
+ * rollback started from.  Deeper rollbacks are counted in the last entry.
+ * Mispredictions a speculative branch had already got right re-run
+ * nothing and aren't counted here.
+ */
+typedef struct GGPOMispredictionStats {
+   int      mispredictions;
+   int      bits[GGPO_MAX_INPUT_BITS];
+   int      frames_ahead[GGPO_MAX_PREDICTION_FRAMES];
+   int      rollback_depth[GGPO_MAX_PREDICTION_FRAMES];
+} GGPOMispredictionStats;
+
 /*
  * ggpo_start_session --
  *
@@ -549,12 +717,293 @@ GGPO_API GGPOErrorCode __cdecl ggpo_set_disconnect_timeout(GGPOSession *,
 GGPO_API GGPOErrorCode __cdecl ggpo_set_disconnect_notify_start(GGPOSession *,
                                                                 int timeout);
 
+/*
+ * ggpo_set_prediction_window --
+ *
+ * Sets how many frames ahead of the last confirmed frame the game may run
+ * before ggpo_add_local_input starts refusing input, and so how many game
+ * states need to be kept for rollback.  Small windows suit low latency
+ * connections, while large ones let games on long distance connections
+ * keep running at the cost of longer rollbacks.  Must be called before the
+ * first call to ggpo_add_local_input.
+ *
+ * frames - The size of the window, from 1 to GGPO_MAX_PREDICTION_FRAMES.
+ * The default is GGPO_DEFAULT_PREDICTION_FRAMES.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_prediction_window(GGPOSession *,
+                                                          int frames);
+
+/*
+ * ggpo_set_keyframe_interval --
+ *
+ * Saves the game state on only every interval'th frame instead of every
+ * frame.  Rollbacks load the closest saved state before the frame being
+ * corrected and re-run the frames in between, so this is worthwhile when
+ * saving the game state costs more than running a frame.  Must be called
+ * before the first call to ggpo_add_local_input.
+ *
+ * interval - How many frames apart saved states are, from 1 (the default)
+ * to GGPO_MAX_PREDICTION_FRAMES.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_keyframe_interval(GGPOSession *,
+                                                          int interval);
+
+/*
+ * ggpo_set_rollback_coalescing --
+ *
+ * By default GGPO.net rolls back as soon as it receives an input which
+ * does not match its prediction, which can mean several rollbacks in one
+ * frame when inputs arrive over several calls to ggpo_idle.  When
+ * coalescing is enabled, mispredictions are only noted as they arrive,
+ * and a single rollback to the earliest of them runs at the start of the
+ * next call to ggpo_add_local_input or ggpo_synchronize_input.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_rollback_coalescing(GGPOSession *,
+                                                            bool enable);
+
+/*
+ * ggpo_set_rollback_budget --
+ *
+ * Limits how long rollbacks may spend re-running frames each frame.  When
+ * a rollback would go over the budget, GGPO.net stops re-running frames
+ * and picks up where it left off in the following calls to ggpo_idle and
+ * ggpo_add_local_input.  Until it has caught back up to where the game
+ * was before the rollback, ggpo_add_local_input returns
+ * GGPO_ERRORCODE_PREDICTION_THRESHOLD, just as it does when the game gets
+ * too far ahead of the remote players.  At least one frame is always run
+ * per call, so rollbacks finish even if the budget is very small.
+ *
+ * budget - The time allowed per frame in microseconds, measured from the
+ * start of ggpo_add_local_input.  0, the default, means no limit.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_rollback_budget(GGPOSession *,
+                                                        int budget);
+
+/*
+ * ggpo_set_snapshot_arena --
+ *
+ * Pre-allocates the buffers used to hold saved game states so that saving
+ * and loading states during the game does not touch the heap.  The
+ * save_game_state_into callback must be implemented.  Must be called before
+ * the first call to ggpo_add_local_input.
+ *
+ * state_size - The largest number of bytes save_game_state_into will ever
+ * write for a single game state.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_snapshot_arena(GGPOSession *,
+                                                       int state_size);
+
+/*
+ * ggpo_set_snapshot_mode --
+ *
+ * Changes how saved game states are stored.  See GGPOSnapshotMode, above.
+ * Must be called before the first call to ggpo_add_local_input.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_snapshot_mode(GGPOSession *,
+                                                      GGPOSnapshotMode mode);
+
+/*
+ * ggpo_set_snapshot_region --
+ *
+ * Registers a single contiguous block of memory which holds the entire
+ * game state, and switches to GGPO_SNAPSHOT_PAGES.  GGPO.net then saves
+ * and restores the block itself: save_game_state is no longer called,
+ * and load_game_state is passed the block after it has been restored, so
+ * it only needs to rebuild anything derived from the game state.  Saved
+ * states have a checksum of 0.  Must be called before the first call to
+ * ggpo_add_local_input.
+ *
+ * Currently only supported on Linux, where the kernel's soft-dirty page
+ * bits are used to find the pages written to each frame.  The bits are
+ * cleared for the whole process, so only one session per process should
+ * register a region.  The block need not be page aligned, and memory
+ * sharing its first and last pages is never touched.
+ *
+ * state - The start of the block.
+ *
+ * size - The size of the block in bytes.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_snapshot_region(GGPOSession *,
+                                                        void *state,
+                                                        int size);
+
+/*
+ * ggpo_set_background_saves --
+ *
+ * Moves the work of saving game states onto a separate thread, so it can
+ * run alongside the game's rendering instead of on the main thread.  Only
+ * saves into a snapshot arena (see ggpo_set_snapshot_arena) in
+ * GGPO_SNAPSHOT_FULL mode are affected, and the arena must be created
+ * first.
+ *
+ * With background saves on, save_game_state_into is called from the
+ * worker thread at some point after ggpo_advance_frame returns.  The game
+ * must not modify its state from the time it calls ggpo_advance_frame
+ * until its next call to ggpo_synchronize_input, which waits for the save
+ * to finish.  Reading the state (to render it, say) is fine.
+ *
+ * enable - true to save on the worker thread, false to go back to saving
+ * on the calling thread.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_background_saves(GGPOSession *,
+                                                         bool enable);
+
+/*
+ * ggpo_set_speculation --
+ *
+ * Uses spare cores to get ahead of rollbacks.  While GGPO.net is
+ * predicting a remote player's input, each of up to branches worker
+ * threads takes a copy of the saved state from before the prediction
+ * started, guesses the player switched to one of their recent inputs
+ * instead, and runs the game forward on that guess with the advance_state
+ * callback.  When the real input arrives and one of the guesses turns out
+ * to be right, its state is loaded in place of re-running the frames with
+ * advance_frame.
+ *
+ * Requires the advance_state callback and a snapshot arena (see
+ * ggpo_set_snapshot_arena) in GGPO_SNAPSHOT_FULL mode.  Saved states which
+ * come from a branch always use the checksum computed by ggpo_checksum.
+ *
+ * branches - The number of worker threads to use, from 0 (the default,
+ * which turns speculation off) to GGPO_MAX_SPECULATIVE_BRANCHES.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_speculation(GGPOSession *,
+                                                    int branches);
+
+/*
+ * ggpo_set_input_predictor --
+ *
+ * Changes how the input of remote players is predicted.  See
+ * GGPOInputPredictor, above.  Must be called before the first call to
+ * ggpo_add_local_input.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_input_predictor(GGPOSession *,
+                                                        GGPOInputPredictor predictor);
+
+/*
+ * ggpo_set_predictor_comparison --
+ *
+ * Runs every input predictor alongside the selected one, so
+ * ggpo_get_prediction_stats can report how each would have done.  Costs
+ * some time on every frame and some memory for each player, so it's off
+ * by default.  Must be called before the first call to
+ * ggpo_add_local_input.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_predictor_comparison(GGPOSession *,
+                                                             bool enable);
+
+/*
+ * ggpo_set_receive_thread --
+ *
+ * Reads and decodes packets from peers on a separate thread as soon as
+ * they arrive, instead of in ggpo_idle and the other calls which poll the
+ * network.  The remote inputs are handed to the session without locking
+ * and picked up the next time it checks the simulation.  The session's
+ * callbacks are still only called from the threads which call into
+ * GGPO.net.  Must not be called from a callback.
+ *
+ * enable - true to start the receive thread, false to stop it and go back
+ * to receiving when polled.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_receive_thread(GGPOSession *,
+                                                       bool enable);
+
+/*
+ * ggpo_set_input_relevance --
+ *
+ * Tells GGPO.net which of a player's input bits currently affect the game
+ * state.  When the real input arrives and differs from the prediction only
+ * in bits which were not relevant, no rollback is done.  Useful for
+ * buttons which are only read some of the time, such as menu or taunt
+ * buttons during play.  The game must really ignore the other bits: any
+ * difference they make to the game state will cause a desync.
+ *
+ * The mask may be changed as often as needed.  It applies to the frames
+ * the game is given a prediction for after the call, so changing it
+ * doesn't affect frames which have already been run.
+ *
+ * player - The player handle returned from the ggpo_add_player function you
+ * used to add the remote player.
+ *
+ * mask - A bitmask the same size as the player's input, with the relevant
+ * bits set.  NULL makes every bit relevant, which is the default.
+ *
+ * size - The size of the mask in bytes.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_input_relevance(GGPOSession *,
+                                                        GGPOPlayerHandle player,
+                                                        void *mask,
+                                                        int size);
+
+/*
+ * ggpo_get_snapshot_stats --
+ *
+ * Used to fetch statistics about the cost of saving and loading game
+ * states.  See GGPOSnapshotStats, above.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_get_snapshot_stats(GGPOSession *,
+                                                       GGPOSnapshotStats *stats);
+
+/*
+ * ggpo_get_prediction_stats --
+ *
+ * Used to fetch statistics about how well a player's input has been
+ * predicted.  See GGPOPredictionStats, above.
+ *
+ * player - The player handle returned from the ggpo_add_player function you
+ * used to add the remote player.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_get_prediction_stats(GGPOSession *,
+                                                         GGPOPlayerHandle player,
+                                                         GGPOPredictionStats *stats);
+
+/*
+ * ggpo_get_misprediction_stats --
+ *
+ * Used to fetch statistics about which of a player's inputs were
+ * mispredicted, and how costly that was.  See GGPOMispredictionStats,
+ * above.
+ *
+ * player - The player handle returned from the ggpo_add_player function you
+ * used to add the remote player.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_get_misprediction_stats(GGPOSession *,
+                                                            GGPOPlayerHandle player,
+                                                            GGPOMispredictionStats *stats);
+
+/*
+ * ggpo_checksum --
+ *
+ * Computes the checksum GGPO.net uses for saved states which were returned
+ * with a checksum of 0 (currently CRC32C, using the processor's crc
+ * instructions when available).  Handy for displaying the checksum of the
+ * current state to help spot desyncs.  Does not require a session.
+ */
+GGPO_API int __cdecl ggpo_checksum(const void *buffer, int len);
+
+/*
+ * ggpo_set_config --
+ *
+ * Changes one of the settings GGPO.net otherwise reads from environment
+ * variables, such as "ggpo.log" or "ggpo.network.delay".  A value set
+ * this way wins over the environment.  Settings are shared by every
+ * session in the process, and the network ones are only looked at as
+ * peers are added, so set them before starting a session.  Does not
+ * require a session.
+ *
+ * name - The name of the setting, which is also the name of its
+ * environment variable.
+ *
+ * value - The new value.  Use 0 or 1 for settings which are on or off.
+ */
+GGPO_API GGPOErrorCode __cdecl ggpo_set_config(const char *name, int value);
+
 /*
  * ggpo_log --
  *
  * Used to write to the ggpo.net log.  In the current versions of the
- * SDK, a log file is only generated if the "quark.log" environment
- * variable is set to 1.  This will change in future versions of the
+ * SDK, a log file is only generated if the "ggpo.log" environment
+ * variable (or setting, see ggpo_set_config) is set to 1.  This will change in future versions of the
  * SDK.
  */
 GGPO_API void __cdecl ggpo_log(GGPOSession *,
@@ -26,6 +26,22 @@ struct GGPOSession {
    virtual GGPOErrorCode SetFrameDelay(GGPOPlayerHandle player, int delay) { return GGPO_ERRORCODE_UNSUPPORTED; }
    virtual GGPOErrorCode SetDisconnectTimeout(int timeout) { return GGPO_ERRORCODE_UNSUPPORTED; }
    virtual GGPOErrorCode SetDisconnectNotifyStart(int timeout) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode SetPredictionWindow(int frames) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode SetKeyframeInterval(int interval) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode SetRollbackCoalescing(bool enable) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode SetRollbackBudget(int budget) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode SetSnapshotArena(int state_size) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode SetSnapshotMode(GGPOSnapshotMode mode) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode SetSnapshotRegion(void *state, int size) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode SetBackgroundSaves(bool enable) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode SetSpeculation(int branches) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode SetInputPredictor(GGPOInputPredictor predictor) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode SetPredictorComparison(bool enable) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode SetReceiveThread(bool enable) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode SetInputRelevance(GGPOPlayerHandle player, void *mask, int size) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode GetSnapshotStats(GGPOSnapshotStats *stats) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode GetPredictionStats(GGPOPlayerHandle player, GGPOPredictionStats *stats) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   virtual GGPOErrorCode GetMispredictionStats(GGPOPlayerHandle player, GGPOMispredictionStats *stats) { return GGPO_ERRORCODE_UNSUPPORTED; }
 };
 
 typedef struct GGPOSession Quark, IQuarkBackend; /* XXX: nuke this */
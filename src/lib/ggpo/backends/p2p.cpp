@@ -35,7 +35,7 @@ Peer2PeerBackend::Peer2PeerBackend(GGPOSessionCallbacks *cb,
    config.num_players = num_players;
    config.input_size = input_size;
    config.callbacks = _callbacks;
-   config.num_prediction_frames = MAX_PREDICTION_FRAMES;
+   config.num_prediction_frames = GGPO_DEFAULT_PREDICTION_FRAMES;
    _sync.Init(config);
 
 //    /*
@@ -63,6 +63,7 @@ Peer2PeerBackend::Peer2PeerBackend(GGPOSessionCallbacks *cb,
   
 Peer2PeerBackend::~Peer2PeerBackend()
 {
+   _steam.StopReceiveThread();
    //delete [] _endpoints;
    delete [] _steam_endpoints;
 }
@@ -90,8 +91,9 @@ Peer2PeerBackend::AddRemotePlayer(CSteamID steam_id, int queue)
     * Start the state machine (xxx: no)
     */
    _synchronizing = true;
-   
-   _steam_endpoints[queue].Init(&_steam, steam_id, _poll, queue, _local_connect_status);
+
+   GGPOSteam::AutoLock lock(_steam);
+   _steam_endpoints[queue].Init(&_steam, steam_id, _poll, queue, _input_size, _local_connect_status);
    _steam_endpoints[queue].SetDisconnectTimeout(_disconnect_timeout);
    _steam_endpoints[queue].SetDisconnectNotifyStart(_disconnect_notify_start);
    _steam_endpoints[queue].Synchronize();
@@ -132,7 +134,8 @@ GGPOErrorCode Peer2PeerBackend::AddSpectator(CSteamID steam_id)
    }
    int queue = _num_spectators++;
 
-   _steam_spectators[queue].Init(&_steam, steam_id, _poll, queue + 1000, _local_connect_status);
+   GGPOSteam::AutoLock lock(_steam);
+   _steam_spectators[queue].Init(&_steam, steam_id, _poll, queue + 1000, _input_size * _num_players, _local_connect_status);
    _steam_spectators[queue].SetDisconnectTimeout(_disconnect_timeout);
    _steam_spectators[queue].SetDisconnectNotifyStart(_disconnect_notify_start);
    _steam_spectators[queue].Synchronize();
@@ -144,7 +147,19 @@ GGPOErrorCode
 Peer2PeerBackend::DoPoll(int timeout)
 {
    if (!_sync.InRollback()) {
+      /*
+       * Everything the endpoints send while we poll goes out in as few
+       * datagrams as possible when EndBatch flushes it below.  The
+       * endpoints are only touched with the Steam lock held, in case
+       * they're receiving on another thread, but their events (the
+       * remote inputs among them) are drained and the simulation run
+       * without it.
+       */
+      _steam.Lock();
+      _steam.BeginBatch();
       _poll.Pump(0);
+      _steam.EndBatch();
+      _steam.Unlock();
 
       //PollUdpProtocolEvents();
       PollSteamProtocolEvents();
@@ -152,6 +167,9 @@ Peer2PeerBackend::DoPoll(int timeout)
       if (!_synchronizing) {
          _sync.CheckSimulation(timeout);
 
+         GGPOSteam::AutoLock lock(_steam);
+         _steam.BeginBatch();
+
          // notify all of our endpoints of their local frame number for their
          // next connection quality report
          int current_frame = _sync.GetFrameCount();
@@ -167,22 +185,37 @@ Peer2PeerBackend::DoPoll(int timeout)
             total_min_confirmed = PollNPlayers(current_frame);
          }
 
+         // a rollback which is still waiting to run needs the inputs from
+         // its first incorrect frame onwards, so they can't be confirmed yet.
+         int pending_rollback = _sync.GetPendingRollbackFrame();
+         if (pending_rollback != GameInput::NullFrame) {
+            total_min_confirmed = MIN(total_min_confirmed, pending_rollback - 1);
+         }
+
          Log("last confirmed frame in p2p backend is %d.\n", total_min_confirmed);
          if (total_min_confirmed >= 0) {
             ASSERT(total_min_confirmed != INT_MAX);
             if (_num_spectators > 0) {
+               char inputs[INPUT_QUEUE_LENGTH * GameInput::Capacity];
+               int frame_size = _input_size * _num_players;
                while (_next_spectator_frame <= total_min_confirmed) {
-                  Log("pushing frame %d to spectators.\n", _next_spectator_frame);
-   
-                  GameInput input;
-                  input.frame = _next_spectator_frame;
-                  input.size = _input_size * _num_players;
-                  _sync.GetConfirmedInputs(input.bits, _input_size * _num_players, _next_spectator_frame);
-                  for (int i = 0; i < _num_spectators; i++) {
-                     //_spectators[i].SendInput(input);
-                     _steam_spectators[i].SendInput(input);
+                  int count = MIN(total_min_confirmed - _next_spectator_frame + 1, INPUT_QUEUE_LENGTH);
+                  count = _sync.GetConfirmedInputs(_next_spectator_frame, count, inputs, sizeof(inputs), NULL);
+                  if (count == 0) {
+                     LogWarning("frame %d isn't in the input queues yet.  not pushing it to spectators.\n", _next_spectator_frame);
+                     break;
+                  }
+                  for (int f = 0; f < count; f++) {
+                     Log("pushing frame %d to spectators.\n", _next_spectator_frame);
+
+                     GameInput input;
+                     input.init(_next_spectator_frame, inputs + (f * frame_size), frame_size);
+                     for (int i = 0; i < _num_spectators; i++) {
+                        //_spectators[i].SendInput(input);
+                        _steam_spectators[i].SendInput(input);
+                     }
+                     _next_spectator_frame++;
                   }
-                  _next_spectator_frame++;
                }
             }
             Log("setting confirmed frame in sync to %d.\n", total_min_confirmed);
@@ -205,10 +238,12 @@ Peer2PeerBackend::DoPoll(int timeout)
                _next_recommended_sleep = current_frame + RECOMMENDATION_INTERVAL;
             }
          }
-         // XXX: this is obviously a farce...
-         if (timeout) {
-            Sleep(1);
-         }
+         _steam.EndBatch();
+      }
+
+      // XXX: this is obviously a farce...
+      if (timeout && !_synchronizing) {
+         Sleep(1);
       }
    }
    return GGPO_OK;
@@ -351,6 +386,7 @@ Peer2PeerBackend::AddLocalInput(GGPOPlayerHandle player,
       _local_connect_status[queue].last_frame = input.frame;
 
       // Send the input to all the remote players.
+      GGPOSteam::AutoLock lock(_steam);
       for (int i = 0; i < _num_players; i++) {
         //  if (_endpoints[i].IsInitialized()) {
         //     _endpoints[i].SendInput(input);
@@ -559,7 +595,9 @@ Peer2PeerBackend::OnSteamProtocolSpectatorEvent(SteamProtocol::Event &evt, int q
    switch (evt.type) {
    case SteamProtocol::Event::Disconnected:
       //_spectators[queue].Disconnect();
+      _steam.Lock();
       _steam_spectators[queue].Disconnect();
+      _steam.Unlock();
 
       info.code = GGPO_EVENTCODE_DISCONNECTED_FROM_PEER;
       info.u.disconnected.player = handle;
@@ -625,7 +663,8 @@ Peer2PeerBackend::DisconnectPlayer(GGPOPlayerHandle player)
    if (!GGPO_SUCCEEDED(result)) {
       return result;
    }
-   
+
+   GGPOSteam::AutoLock lock(_steam);
    if (_local_connect_status[queue].disconnected) {
       return GGPO_ERRORCODE_PLAYER_DISCONNECTED;
    }
@@ -635,7 +674,7 @@ Peer2PeerBackend::DisconnectPlayer(GGPOPlayerHandle player)
       int current_frame = _sync.GetFrameCount();
       // xxx: we should be tracking who the local player is, but for now assume
       // that if the endpoint is not initalized, this must be the local player.
-      Log("Disconnecting local player %d at frame %d by user request.\n", queue, _local_connect_status[queue].last_frame);
+      LogInfo("Disconnecting local player %d at frame %d by user request.\n", queue, _local_connect_status[queue].last_frame);
       for (int i = 0; i < _num_players; i++) {
          //if (_endpoints[i].IsInitialized()) {
          if (_steam_endpoints[i].IsInitialized()) {
@@ -643,7 +682,7 @@ Peer2PeerBackend::DisconnectPlayer(GGPOPlayerHandle player)
          }
       }
    } else {
-      Log("Disconnecting queue %d at frame %d by user request.\n", queue, _local_connect_status[queue].last_frame);
+      LogInfo("Disconnecting queue %d at frame %d by user request.\n", queue, _local_connect_status[queue].last_frame);
       DisconnectPlayerQueue(queue, _local_connect_status[queue].last_frame);
    }
    return GGPO_OK;
@@ -690,6 +729,7 @@ Peer2PeerBackend::GetNetworkStats(GGPONetworkStats *stats, GGPOPlayerHandle play
    }
 
    memset(stats, 0, sizeof *stats);
+   GGPOSteam::AutoLock lock(_steam);
    //_endpoints[queue].GetNetworkStats(stats);
    _steam_endpoints[queue].GetNetworkStats(stats);
 
@@ -714,6 +754,7 @@ GGPOErrorCode
 Peer2PeerBackend::SetDisconnectTimeout(int timeout)
 {
    _disconnect_timeout = timeout;
+   GGPOSteam::AutoLock lock(_steam);
    for (int i = 0; i < _num_players; i++) {
     //   if (_endpoints[i].IsInitialized()) {
     //      _endpoints[i].SetDisconnectTimeout(_disconnect_timeout);
@@ -729,6 +770,7 @@ GGPOErrorCode
 Peer2PeerBackend::SetDisconnectNotifyStart(int timeout)
 {
    _disconnect_notify_start = timeout;
+   GGPOSteam::AutoLock lock(_steam);
    for (int i = 0; i < _num_players; i++) {
     //   if (_endpoints[i].IsInitialized()) {
     //      _endpoints[i].SetDisconnectNotifyStart(_disconnect_notify_start);
@@ -740,6 +782,172 @@ Peer2PeerBackend::SetDisconnectNotifyStart(int timeout)
    return GGPO_OK;
 }
 
+GGPOErrorCode
+Peer2PeerBackend::SetPredictionWindow(int frames)
+{
+   if (frames < 1 || frames > GGPO_MAX_PREDICTION_FRAMES) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   if (!_sync.SetPredictionWindow(frames)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::SetKeyframeInterval(int interval)
+{
+   if (interval < 1 || interval > GGPO_MAX_PREDICTION_FRAMES) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   if (!_sync.SetKeyframeInterval(interval)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::SetRollbackCoalescing(bool enable)
+{
+   _sync.SetRollbackCoalescing(enable);
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::SetRollbackBudget(int budget)
+{
+   if (budget < 0) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   _sync.SetRollbackBudget(budget);
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::SetSnapshotArena(int state_size)
+{
+   if (!_sync.SetSnapshotArena(state_size)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::SetSnapshotMode(GGPOSnapshotMode mode)
+{
+   if (!_sync.SetSnapshotMode(mode)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::SetSnapshotRegion(void *state, int size)
+{
+   if (!_sync.SetSnapshotRegion(state, size)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::SetBackgroundSaves(bool enable)
+{
+   if (!_sync.SetBackgroundSaves(enable)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::SetSpeculation(int branches)
+{
+   if (!_sync.SetSpeculation(branches)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::SetInputPredictor(GGPOInputPredictor predictor)
+{
+   if (!_sync.SetInputPredictor(predictor)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::SetPredictorComparison(bool enable)
+{
+   if (!_sync.SetPredictorComparison(enable)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::SetReceiveThread(bool enable)
+{
+   if (!enable) {
+      _steam.StopReceiveThread();
+   } else if (!_steam.StartReceiveThread()) {
+      return GGPO_ERRORCODE_GENERAL_FAILURE;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::SetInputRelevance(GGPOPlayerHandle player, void *mask, int size)
+{
+   int queue;
+   GGPOErrorCode result;
+
+   result = PlayerHandleToQueue(player, &queue);
+   if (!GGPO_SUCCEEDED(result)) {
+      return result;
+   }
+   if (!_sync.SetInputRelevance(queue, mask, size)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::GetSnapshotStats(GGPOSnapshotStats *stats)
+{
+   _sync.GetSnapshotStats(stats);
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::GetPredictionStats(GGPOPlayerHandle player, GGPOPredictionStats *stats)
+{
+   int queue;
+   GGPOErrorCode result;
+
+   result = PlayerHandleToQueue(player, &queue);
+   if (!GGPO_SUCCEEDED(result)) {
+      return result;
+   }
+   _sync.GetPredictionStats(queue, stats);
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+Peer2PeerBackend::GetMispredictionStats(GGPOPlayerHandle player, GGPOMispredictionStats *stats)
+{
+   int queue;
+   GGPOErrorCode result;
+
+   result = PlayerHandleToQueue(player, &queue);
+   if (!GGPO_SUCCEEDED(result)) {
+      return result;
+   }
+   _sync.GetMispredictionStats(queue, stats);
+   return GGPO_OK;
+}
+
 GGPOErrorCode
 Peer2PeerBackend::PlayerHandleToQueue(GGPOPlayerHandle player, int *queue)
 {
@@ -791,6 +999,7 @@ Peer2PeerBackend::CheckInitialSync()
 {
    int i;
 
+   GGPOSteam::AutoLock lock(_steam);
    if (_synchronizing) {
       // Check to see if everyone is now synchronized.  If so,
       // go ahead and tell the client that we're ok to accept input.
@@ -33,6 +33,22 @@ public:
    virtual GGPOErrorCode SetFrameDelay(GGPOPlayerHandle player, int delay);
    virtual GGPOErrorCode SetDisconnectTimeout(int timeout);
    virtual GGPOErrorCode SetDisconnectNotifyStart(int timeout);
+   virtual GGPOErrorCode SetPredictionWindow(int frames);
+   virtual GGPOErrorCode SetKeyframeInterval(int interval);
+   virtual GGPOErrorCode SetRollbackCoalescing(bool enable);
+   virtual GGPOErrorCode SetRollbackBudget(int budget);
+   virtual GGPOErrorCode SetSnapshotArena(int state_size);
+   virtual GGPOErrorCode SetSnapshotMode(GGPOSnapshotMode mode);
+   virtual GGPOErrorCode SetSnapshotRegion(void *state, int size);
+   virtual GGPOErrorCode SetBackgroundSaves(bool enable);
+   virtual GGPOErrorCode SetSpeculation(int branches);
+   virtual GGPOErrorCode SetInputPredictor(GGPOInputPredictor predictor);
+   virtual GGPOErrorCode SetPredictorComparison(bool enable);
+   virtual GGPOErrorCode SetReceiveThread(bool enable);
+   virtual GGPOErrorCode SetInputRelevance(GGPOPlayerHandle player, void *mask, int size);
+   virtual GGPOErrorCode GetSnapshotStats(GGPOSnapshotStats *stats);
+   virtual GGPOErrorCode GetPredictionStats(GGPOPlayerHandle player, GGPOPredictionStats *stats);
+   virtual GGPOErrorCode GetMispredictionStats(GGPOPlayerHandle player, GGPOMispredictionStats *stats);
 
 public:
    //virtual void OnMsg(sockaddr_in &from, UdpMsg *msg, int len);
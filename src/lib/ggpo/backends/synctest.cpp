@@ -28,7 +28,7 @@ SyncTestBackend::SyncTestBackend(GGPOSessionCallbacks *cb,
     */
    Sync::Config config = { 0 };
    config.callbacks = _callbacks;
-   config.num_prediction_frames = MAX_PREDICTION_FRAMES;
+   config.num_prediction_frames = GGPO_DEFAULT_PREDICTION_FRAMES;
    _sync.Init(config);
 
    /*
@@ -157,6 +157,40 @@ SyncTestBackend::IncrementFrame(void)
    return GGPO_OK;
 }
 
+GGPOErrorCode
+SyncTestBackend::SetSnapshotArena(int state_size)
+{
+   if (!_sync.SetSnapshotArena(state_size)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+SyncTestBackend::SetSnapshotMode(GGPOSnapshotMode mode)
+{
+   if (!_sync.SetSnapshotMode(mode)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+SyncTestBackend::SetSnapshotRegion(void *state, int size)
+{
+   if (!_sync.SetSnapshotRegion(state, size)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+SyncTestBackend::GetSnapshotStats(GGPOSnapshotStats *stats)
+{
+   _sync.GetSnapshotStats(stats);
+   return GGPO_OK;
+}
+
 void
 SyncTestBackend::RaiseSyncError(const char *fmt, ...)
 {
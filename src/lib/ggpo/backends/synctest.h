@@ -24,6 +24,10 @@ public:
    virtual GGPOErrorCode SyncInput(void *values, int size, int *disconnect_flags);
    virtual GGPOErrorCode IncrementFrame(void);
    virtual GGPOErrorCode Logv(char *fmt, va_list list);
+   virtual GGPOErrorCode SetSnapshotArena(int state_size);
+   virtual GGPOErrorCode SetSnapshotMode(GGPOSnapshotMode mode);
+   virtual GGPOErrorCode SetSnapshotRegion(void *state, int size);
+   virtual GGPOErrorCode GetSnapshotStats(GGPOSnapshotStats *stats);
 
 protected:
    struct SavedInfo {
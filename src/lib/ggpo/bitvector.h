@@ -8,7 +8,26 @@
 #ifndef _BITVECTOR_H
 #define _BITVECTOR_H
 
-#define BITVECTOR_NIBBLE_SIZE 8
+#include "game_input.h"
+
+/*
+ * Wide enough to name every bit of a GameInput.  The input_size sent on
+ * the wire is a single byte, so the capacity can't grow past that.
+ */
+#if GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS * 8 < (1 << 8)
+#  define BITVECTOR_NIBBLE_SIZE 8
+#elif GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS * 8 < (1 << 11)
+#  define BITVECTOR_NIBBLE_SIZE 11
+#else
+#  error GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS is too large
+#endif
+
+/*
+ * The most bits one frame of size bytes can take in the input stream, when
+ * every bit changed: a flag, the new value and the bit's number for each,
+ * then the flag ending the frame.
+ */
+#define BITVECTOR_MAX_FRAME_BITS(size)    ((size) * 8 * (2 + BITVECTOR_NIBBLE_SIZE) + 1)
 
 void BitVector_SetBit(ggpo::uint8 *vector, int *offset);
 void BitVector_ClearBit(ggpo::uint8 *vector, int *offset);
@@ -0,0 +1,222 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#include <string.h>
+#include "types.h"
+#include "bytemask.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define BYTEMASK_SSE2
+#endif
+
+/*
+ * lowest_bit[m] is the index of the lowest bit set in m.
+ */
+static ggpo::uint8 lowest_bit[256];
+static bool tables_ready = false;
+
+static void
+ByteMask_InitTables()
+{
+   for (int m = 1; m < 256; m++) {
+      int i = 0;
+      while (!(m & (1 << i))) {
+         i++;
+      }
+      lowest_bit[m] = (ggpo::uint8)i;
+   }
+   tables_ready = true;
+}
+
+/*
+ * Writes a bit for each of the size bytes of current which differ from
+ * last into mask, and returns whether any did.
+ */
+static bool
+ByteMask_Compare(const char *last, const char *current, int size, ggpo::uint8 *mask)
+{
+   int i = 0;
+   bool changed = false;
+
+#if defined(BYTEMASK_SSE2)
+   for (; i + 16 <= size; i += 16) {
+      __m128i a = _mm_loadu_si128((const __m128i *)(last + i));
+      __m128i b = _mm_loadu_si128((const __m128i *)(current + i));
+      int diff = ~_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) & 0xffff;
+      mask[i / 8] = (ggpo::uint8)diff;
+      mask[i / 8 + 1] = (ggpo::uint8)(diff >> 8);
+      changed = changed || diff;
+   }
+#endif
+   for (; i < size; i += 8) {
+      int n = MIN(8, size - i);
+      ggpo::uint8 m = 0;
+      for (int j = 0; j < n; j += 4) {
+         if (n - j >= 4) {
+            ggpo::uint32 a, b;
+            memcpy(&a, last + i + j, sizeof(a));
+            memcpy(&b, current + i + j, sizeof(b));
+            if (a == b) {
+               continue;
+            }
+         }
+         for (int k = j; k < n && k < j + 4; k++) {
+            if (last[i + k] != current[i + k]) {
+               m |= 1 << k;
+            }
+         }
+      }
+      mask[i / 8] = m;
+      changed = changed || m;
+   }
+   return changed;
+}
+
+void
+ByteMask_Begin(ByteMaskWriter *writer, ggpo::uint8 *out, int capacity, int size)
+{
+   ASSERT(size <= BYTEMASK_MAX_SIZE);
+   ASSERT(capacity >= 2);
+
+   writer->out = out;
+   writer->capacity = capacity;
+   writer->size = size;
+   writer->count = 0;
+   out[0] = 0;
+   out[1] = 0;
+   writer->skip = 1;
+   writer->offset = 2;
+}
+
+/*
+ * Adds the next frame.  Returns false, leaving the stream as it was, if
+ * the frame won't fit in the buffer or there are already
+ * BYTEMASK_MAX_FRAMES in it.
+ */
+bool
+ByteMask_WriteFrame(ByteMaskWriter *writer, const char *last, const char *current)
+{
+   ggpo::uint8 *out = writer->out;
+   ggpo::uint8 mask[(BYTEMASK_MAX_SIZE + 7) / 8 + 1];
+   int mask_size = (writer->size + 7) / 8;
+
+   if (writer->count == BYTEMASK_MAX_FRAMES) {
+      return false;
+   }
+   if (!tables_ready) {
+      ByteMask_InitTables();
+   }
+   if (!ByteMask_Compare(last, current, writer->size, mask)) {
+      out[writer->skip]++;
+      writer->count++;
+      return true;
+   }
+
+   /*
+    * The mask, the changed bytes and the next run's skip byte.
+    */
+   int changed = 0;
+   for (int i = 0; i < mask_size; i++) {
+      for (int m = mask[i]; m; m &= m - 1) {
+         changed++;
+      }
+   }
+   if (writer->offset + mask_size + changed + 1 > writer->capacity) {
+      return false;
+   }
+
+   int offset = writer->offset;
+   memcpy(out + offset, mask, mask_size);
+   offset += mask_size;
+   for (int i = 0; i < mask_size; i++) {
+      for (int m = mask[i]; m; m &= m - 1) {
+         out[offset++] = current[i * 8 + lowest_bit[m]];
+      }
+   }
+   out[offset] = 0;
+   writer->skip = offset;
+   writer->offset = offset + 1;
+   writer->count++;
+   return true;
+}
+
+/*
+ * Returns the number of bytes written.
+ */
+int
+ByteMask_End(ByteMaskWriter *writer)
+{
+   writer->out[0] = (ggpo::uint8)writer->count;
+   return writer->offset;
+}
+
+bool
+ByteMask_BeginRead(ByteMaskReader *reader, const ggpo::uint8 *in, int len, int size)
+{
+   if (!tables_ready) {
+      ByteMask_InitTables();
+   }
+   if (len < 2) {
+      return false;
+   }
+   reader->in = in;
+   reader->len = len;
+   reader->size = size;
+   reader->remaining = in[0];
+   reader->skip = in[1];
+   reader->offset = 2;
+   return true;
+}
+
+/*
+ * Applies the next frame's changes to bits, which should hold the frame
+ * before it, or just steps past them if bits is NULL.  Returns false at
+ * the end of the stream, or if it's malformed.
+ */
+bool
+ByteMask_ReadFrame(ByteMaskReader *reader, char *bits)
+{
+   if (reader->remaining == 0) {
+      return false;
+   }
+   reader->remaining--;
+   if (reader->skip) {
+      reader->skip--;
+      return true;
+   }
+
+   const ggpo::uint8 *in = reader->in;
+   int mask_size = (reader->size + 7) / 8;
+   int offset = reader->offset;
+   if (offset + mask_size > reader->len) {
+      return false;
+   }
+   const ggpo::uint8 *mask = in + offset;
+   offset += mask_size;
+   for (int i = 0; i < mask_size; i++) {
+      for (int m = mask[i]; m; m &= m - 1) {
+         if (offset >= reader->len) {
+            return false;
+         }
+         int index = i * 8 + lowest_bit[m];
+         if (index >= reader->size) {
+            return false;
+         }
+         int b = in[offset++];
+         if (bits) {
+            bits[index] = (char)b;
+         }
+      }
+   }
+   if (offset >= reader->len) {
+      return false;
+   }
+   reader->skip = in[offset++];
+   reader->offset = offset;
+   return true;
+}
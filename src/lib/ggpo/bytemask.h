@@ -0,0 +1,63 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#ifndef _BYTEMASK_H
+#define _BYTEMASK_H
+
+#include "types.h"
+
+/*
+ * The byte mask input codec.  Each frame is compared with the one before
+ * it (16 bytes at a time with SSE2, a word at a time otherwise), and only
+ * the bytes which changed are sent, after a mask saying which ones they
+ * are.  A run of frames which didn't change at all costs one byte.
+ *
+ *    count                      frames in the stream
+ *    { skip, mask, bytes } ...  skip unchanged frames, then one frame's
+ *                               mask (a bit per input byte) and the new
+ *                               value of each byte set in the mask
+ *    skip                       any unchanged frames at the end
+ *
+ * Everything is byte aligned, so the decoder walks masks with a table
+ * rather than reading a bit at a time like BitVector.
+ */
+
+#define BYTEMASK_MAX_FRAMES      255
+#define BYTEMASK_MAX_SIZE        255      /* input_size goes on the wire as a byte */
+
+/*
+ * The most a stream holding one frame of size bytes can take, when every
+ * byte changed.
+ */
+#define BYTEMASK_MAX_FRAME_SIZE(size)     (3 + ((size) + 7) / 8 + (size))
+
+struct ByteMaskWriter {
+   ggpo::uint8    *out;
+   int            offset;
+   int            capacity;      /* bytes out can hold */
+   int            skip;          /* where the current run's skip byte is */
+   int            count;         /* frames written */
+   int            size;
+};
+
+void ByteMask_Begin(ByteMaskWriter *writer, ggpo::uint8 *out, int capacity, int size);
+bool ByteMask_WriteFrame(ByteMaskWriter *writer, const char *last, const char *current);
+int ByteMask_End(ByteMaskWriter *writer);
+
+struct ByteMaskReader {
+   const ggpo::uint8 *in;
+   int            offset;
+   int            len;
+   int            remaining;     /* frames left in the stream */
+   int            skip;          /* unchanged frames left in the current run */
+   int            size;
+};
+
+bool ByteMask_BeginRead(ByteMaskReader *reader, const ggpo::uint8 *in, int len, int size);
+bool ByteMask_ReadFrame(ByteMaskReader *reader, char *bits);
+
+#endif
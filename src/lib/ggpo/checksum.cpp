@@ -0,0 +1,208 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#include <string.h>
+#include "types.h"
+#include "checksum.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  include <intrin.h>
+#  include <nmmintrin.h>
+#  define CHECKSUM_X86
+#  define CHECKSUM_TARGET
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  include <cpuid.h>
+#  include <nmmintrin.h>
+#  define CHECKSUM_X86
+#  define CHECKSUM_TARGET  __attribute__((target("sse4.2")))
+#elif defined(__GNUC__) && defined(__ARM_FEATURE_CRC32)
+#  include <arm_acle.h>
+#  define CHECKSUM_ARM
+#  define CHECKSUM_TARGET
+#endif
+
+#if defined(CHECKSUM_X86) && (defined(_M_X64) || defined(__x86_64__))
+#  define CRC32C_U64(crc, v)    ((ggpo::uint32)_mm_crc32_u64((crc), (v)))
+#  define CRC32C_U8(crc, v)     _mm_crc32_u8((crc), (v))
+#elif defined(CHECKSUM_X86)
+#  define CRC32C_U64(crc, v)    _mm_crc32_u32(_mm_crc32_u32((crc), (ggpo::uint32)(v)), (ggpo::uint32)((v) >> 32))
+#  define CRC32C_U8(crc, v)     _mm_crc32_u8((crc), (v))
+#elif defined(CHECKSUM_ARM)
+#  define CRC32C_U64(crc, v)    __crc32cd((crc), (v))
+#  define CRC32C_U8(crc, v)     __crc32cb((crc), (v))
+#endif
+
+#define CRC32C_POLY     0x82f63b78
+
+/*
+ * The crc instructions take a few cycles to produce a result, but can
+ * start a new one every cycle, so large buffers are done as three
+ * independent runs of this many bytes at a time.  The runs are stitched
+ * back together with ShiftBlock.
+ */
+#define CRC32C_BLOCK    256
+
+static ggpo::uint32 crc_table[8][256];
+static ggpo::uint32 shift_table[4][256];
+
+static bool
+Checksum_InitTables()
+{
+   for (int i = 0; i < 256; i++) {
+      ggpo::uint32 crc = i;
+      for (int j = 0; j < 8; j++) {
+         crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+      }
+      crc_table[0][i] = crc;
+   }
+   for (int i = 0; i < 256; i++) {
+      for (int k = 1; k < 8; k++) {
+         crc_table[k][i] = (crc_table[k - 1][i] >> 8) ^ crc_table[0][crc_table[k - 1][i] & 0xff];
+      }
+   }
+
+   /*
+    * Running the crc over a block of zeros is linear in the starting crc,
+    * so it can be done a byte of the crc at a time from a table built from
+    * what happens to each bit.
+    */
+   ggpo::uint32 basis[32];
+   for (int bit = 0; bit < 32; bit++) {
+      ggpo::uint32 crc = 1u << bit;
+      for (int n = 0; n < CRC32C_BLOCK; n++) {
+         crc = (crc >> 8) ^ crc_table[0][crc & 0xff];
+      }
+      basis[bit] = crc;
+   }
+   for (int k = 0; k < 4; k++) {
+      for (int i = 0; i < 256; i++) {
+         ggpo::uint32 crc = 0;
+         for (int bit = 0; bit < 8; bit++) {
+            if (i & (1 << bit)) {
+               crc ^= basis[(k * 8) + bit];
+            }
+         }
+         shift_table[k][i] = crc;
+      }
+   }
+   return true;
+}
+
+/*
+ * Returns the crc after CRC32C_BLOCK more zero bytes.  XORing that with
+ * the crc of the next block started from 0 gives the crc of both blocks.
+ */
+static inline ggpo::uint32
+Checksum_ShiftBlock(ggpo::uint32 crc)
+{
+   return shift_table[0][crc & 0xff] ^
+          shift_table[1][(crc >> 8) & 0xff] ^
+          shift_table[2][(crc >> 16) & 0xff] ^
+          shift_table[3][crc >> 24];
+}
+
+static inline ggpo::uint64
+Checksum_Load64(const ggpo::byte *p)
+{
+   ggpo::uint64 v;
+   memcpy(&v, p, sizeof(v));
+   return v;
+}
+
+static ggpo::uint32
+Checksum_Crc32cTable(ggpo::uint32 crc, const ggpo::byte *p, int len)
+{
+   while (len >= 8) {
+      ggpo::uint32 lo = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | ((ggpo::uint32)p[3] << 24));
+      ggpo::uint32 hi = p[4] | (p[5] << 8) | (p[6] << 16) | ((ggpo::uint32)p[7] << 24);
+      crc = crc_table[7][lo & 0xff] ^
+            crc_table[6][(lo >> 8) & 0xff] ^
+            crc_table[5][(lo >> 16) & 0xff] ^
+            crc_table[4][lo >> 24] ^
+            crc_table[3][hi & 0xff] ^
+            crc_table[2][(hi >> 8) & 0xff] ^
+            crc_table[1][(hi >> 16) & 0xff] ^
+            crc_table[0][hi >> 24];
+      p += 8;
+      len -= 8;
+   }
+   while (len--) {
+      crc = (crc >> 8) ^ crc_table[0][(crc ^ *p++) & 0xff];
+   }
+   return crc;
+}
+
+#if defined(CRC32C_U64)
+
+static ggpo::uint32 CHECKSUM_TARGET
+Checksum_Crc32cHardware(ggpo::uint32 crc, const ggpo::byte *p, int len)
+{
+   while (len >= 3 * CRC32C_BLOCK) {
+      ggpo::uint32 a = crc, b = 0, c = 0;
+      for (int i = 0; i < CRC32C_BLOCK; i += 8) {
+         a = CRC32C_U64(a, Checksum_Load64(p + i));
+         b = CRC32C_U64(b, Checksum_Load64(p + CRC32C_BLOCK + i));
+         c = CRC32C_U64(c, Checksum_Load64(p + (2 * CRC32C_BLOCK) + i));
+      }
+      crc = Checksum_ShiftBlock(Checksum_ShiftBlock(a) ^ b) ^ c;
+      p += 3 * CRC32C_BLOCK;
+      len -= 3 * CRC32C_BLOCK;
+   }
+   while (len >= 8) {
+      crc = CRC32C_U64(crc, Checksum_Load64(p));
+      p += 8;
+      len -= 8;
+   }
+   while (len--) {
+      crc = CRC32C_U8(crc, *p++);
+   }
+   return crc;
+}
+
+#endif
+
+static bool
+Checksum_HasHardware()
+{
+#if defined(CHECKSUM_X86)
+#  if defined(_MSC_VER)
+   int info[4];
+   __cpuid(info, 1);
+   return ((info[2] >> 20) & 1) != 0;
+#  else
+   unsigned int eax, ebx, ecx, edx;
+   return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && ((ecx >> 20) & 1);
+#  endif
+#elif defined(CHECKSUM_ARM)
+   return true;
+#else
+   return false;
+#endif
+}
+
+ggpo::uint32
+Checksum_Crc32c(const void *data, int len)
+{
+   const ggpo::byte *p = (const ggpo::byte *)data;
+   ggpo::uint32 crc = 0xffffffff;
+
+   /*
+    * The background save worker and ggpo_checksum callers may get here
+    * on any thread.  Local statics are initialized once, by whichever
+    * gets here first, and the rest wait for it to finish.
+    */
+   static const bool tables_ready = Checksum_InitTables();
+   static const bool has_hardware = Checksum_HasHardware();
+   (void)tables_ready;
+
+#if defined(CRC32C_U64)
+   if (has_hardware) {
+      return ~Checksum_Crc32cHardware(crc, p, len);
+   }
+#endif
+   return ~Checksum_Crc32cTable(crc, p, len);
+}
@@ -0,0 +1,19 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#ifndef _CHECKSUM_H
+#define _CHECKSUM_H
+
+/*
+ * CRC32C (Castagnoli) of a buffer.  Uses the SSE4.2 or ARMv8 CRC
+ * instructions when the processor has them, and a table driven version
+ * otherwise.  All versions produce the same result.
+ */
+
+ggpo::uint32 Checksum_Crc32c(const void *data, int len);
+
+#endif // _CHECKSUM_H
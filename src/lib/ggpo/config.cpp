@@ -0,0 +1,82 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#include <stddef.h>
+#include <string.h>
+#include "types.h"
+#include "config.h"
+
+ConfigValues ggpo_config;
+
+enum ConfigType {
+   CONFIG_BOOL,
+   CONFIG_INT,
+};
+
+static const struct ConfigEntry {
+   const char     *name;
+   ConfigType     type;
+   size_t         offset;
+} entries[] = {
+   { "ggpo.log",              CONFIG_BOOL,   offsetof(ConfigValues, log) },
+   { "ggpo.log.ignore",       CONFIG_BOOL,   offsetof(ConfigValues, log_ignore) },
+   { "ggpo.log.level",        CONFIG_INT,    offsetof(ConfigValues, log_level) },
+   { "ggpo.log.trace",        CONFIG_BOOL,   offsetof(ConfigValues, log_trace) },
+   { "ggpo.log.timestamps",   CONFIG_BOOL,   offsetof(ConfigValues, log_timestamps) },
+   { "ggpo.network.delay",    CONFIG_INT,    offsetof(ConfigValues, network_delay) },
+   { "ggpo.network.reliable", CONFIG_BOOL,   offsetof(ConfigValues, network_reliable) },
+   { "ggpo.oop.percent",      CONFIG_INT,    offsetof(ConfigValues, oop_percent) },
+};
+
+static bool loaded = false;
+static bool overridden[ARRAY_SIZE(entries)];
+
+static void
+ConfigStore(const ConfigEntry &entry, int value)
+{
+   char *field = (char *)&ggpo_config + entry.offset;
+   if (entry.type == CONFIG_BOOL) {
+      *(bool *)field = value != 0;
+   } else {
+      *(int *)field = value;
+   }
+}
+
+void
+ConfigLoad()
+{
+   if (loaded) {
+      return;
+   }
+   for (int i = 0; i < ARRAY_SIZE(entries); i++) {
+      if (overridden[i]) {
+         continue;
+      }
+      if (entries[i].type == CONFIG_BOOL) {
+         ConfigStore(entries[i], Platform::GetConfigBool(entries[i].name));
+      } else {
+         ConfigStore(entries[i], Platform::GetConfigInt(entries[i].name));
+      }
+   }
+   loaded = true;
+}
+
+bool
+ConfigSet(const char *name, int value)
+{
+   for (int i = 0; i < ARRAY_SIZE(entries); i++) {
+      if (!strcmp(entries[i].name, name)) {
+         ConfigStore(entries[i], value);
+         overridden[i] = true;
+         if (!strncmp(name, "ggpo.log", 8)) {
+            log_level = -1;      /* make the log look at its settings again */
+         }
+         return true;
+      }
+   }
+   return false;
+}
@@ -0,0 +1,33 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+
+/*
+ * Settings which don't have an API of their own, mostly for debugging.
+ * Each is read from the environment variable of the same name when the
+ * first session starts, unless ggpo_set_config got to it first.  After
+ * that they're plain fields, so read them wherever they're needed.
+ */
+struct ConfigValues {
+   bool     log;                 /* ggpo.log - write log-<pid>.log */
+   bool     log_ignore;          /* ggpo.log.ignore - overrides ggpo.log */
+   int      log_level;           /* ggpo.log.level - see LOG_LEVEL_* */
+   bool     log_trace;           /* ggpo.log.trace - see trace.h */
+   bool     log_timestamps;      /* ggpo.log.timestamps */
+   int      network_delay;       /* ggpo.network.delay - ms added to each send */
+   bool     network_reliable;    /* ggpo.network.reliable - send every message reliably */
+   int      oop_percent;         /* ggpo.oop.percent - % of packets sent out of order */
+};
+
+extern ConfigValues ggpo_config;
+
+extern void ConfigLoad();
+extern bool ConfigSet(const char *name, int value);
+
+#endif
@@ -0,0 +1,132 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#include <string.h>
+#include "types.h"
+#include "delta.h"
+
+/*
+ * Runs of unchanged bytes shorter than this are folded into the
+ * surrounding changed run, since the two varints it would take to skip
+ * them cost about as much as the bytes themselves.
+ */
+#define DELTA_MIN_SKIP     8
+
+static inline ggpo::byte
+Delta_ByteAt(const ggpo::byte *buf, int len, int i)
+{
+   return i < len ? buf[i] : 0;
+}
+
+static inline void
+Delta_Put(ggpo::byte *dst, int capacity, int *offset, ggpo::byte value)
+{
+   if (*offset < capacity) {
+      dst[*offset] = value;
+   }
+   (*offset)++;
+}
+
+static inline void
+Delta_PutVarint(ggpo::byte *dst, int capacity, int *offset, int value)
+{
+   while (value >= 0x80) {
+      Delta_Put(dst, capacity, offset, (ggpo::byte)(value | 0x80));
+      value >>= 7;
+   }
+   Delta_Put(dst, capacity, offset, (ggpo::byte)value);
+}
+
+static inline int
+Delta_GetVarint(const ggpo::byte *delta, int *offset)
+{
+   int value = 0, shift = 0;
+   ggpo::byte b;
+   do {
+      b = delta[(*offset)++];
+      value |= (b & 0x7f) << shift;
+      shift += 7;
+   } while (b & 0x80);
+   return value;
+}
+
+/*
+ * Writes the delta from 'from' to 'to' into dst and returns its length.
+ * If the delta needs more than capacity bytes, only the first capacity
+ * bytes are written but the full length is still returned so the caller
+ * can grow dst and try again.
+ */
+int
+Delta_Encode(ggpo::byte *dst, int capacity, const ggpo::byte *from, int from_len, const ggpo::byte *to, int to_len)
+{
+   int len = MAX(from_len, to_len);
+   int common = MIN(from_len, to_len);
+   int offset = 0, last = 0, i = 0;
+
+   while (i < len) {
+      /*
+       * Skip over the unchanged bytes a word at a time for as long as both
+       * buffers have data, then finish byte by byte.
+       */
+      while (i + (int)sizeof(size_t) <= common) {
+         size_t a, b;
+         memcpy(&a, from + i, sizeof(a));
+         memcpy(&b, to + i, sizeof(b));
+         if (a != b) {
+            break;
+         }
+         i += sizeof(size_t);
+      }
+      while (i < len && Delta_ByteAt(from, from_len, i) == Delta_ByteAt(to, to_len, i)) {
+         i++;
+      }
+      if (i == len) {
+         break;
+      }
+
+      /*
+       * Find the end of the changed run, allowing short unchanged gaps.
+       */
+      int start = i, end = i, gap = 0;
+      while (i < len && gap < DELTA_MIN_SKIP) {
+         if (Delta_ByteAt(from, from_len, i) != Delta_ByteAt(to, to_len, i)) {
+            end = i + 1;
+            gap = 0;
+         } else {
+            gap++;
+         }
+         i++;
+      }
+
+      Delta_PutVarint(dst, capacity, &offset, start - last);
+      Delta_PutVarint(dst, capacity, &offset, end - start);
+      for (int j = start; j < end; j++) {
+         Delta_Put(dst, capacity, &offset, Delta_ByteAt(from, from_len, j) ^ Delta_ByteAt(to, to_len, j));
+      }
+      last = i = end;
+   }
+   return offset;
+}
+
+/*
+ * XORs the delta into buf.  buf must be large enough to hold the longer
+ * of the two buffers the delta was made from.
+ */
+void
+Delta_Apply(ggpo::byte *buf, const ggpo::byte *delta, int len)
+{
+   int offset = 0, pos = 0;
+
+   while (offset < len) {
+      pos += Delta_GetVarint(delta, &offset);
+      int count = Delta_GetVarint(delta, &offset);
+      ASSERT(offset + count <= len);
+      for (int i = 0; i < count; i++) {
+         buf[pos++] ^= delta[offset++];
+      }
+   }
+}
@@ -0,0 +1,22 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#ifndef _DELTA_H
+#define _DELTA_H
+
+/*
+ * XOR/RLE deltas between two buffers.  A delta is a list of runs, each
+ * stored as a varint count of unchanged bytes to skip, a varint count of
+ * changed bytes and then the XOR of the old and new values of those bytes.
+ * Bytes past the end of the shorter buffer are treated as zero.  Since the
+ * delta is an XOR, applying it to either buffer produces the other one.
+ */
+
+int Delta_Encode(ggpo::byte *dst, int capacity, const ggpo::byte *from, int from_len, const ggpo::byte *to, int to_len);
+void Delta_Apply(ggpo::byte *buf, const ggpo::byte *delta, int len);
+
+#endif // _DELTA_H
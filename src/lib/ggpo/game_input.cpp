@@ -9,34 +9,8 @@
 #include "game_input.h"
 #include "log.h"
 
-void
-GameInput::init(int iframe, char *ibits, int isize, int offset)
-{
-   ASSERT(isize);
-   ASSERT(isize <= GAMEINPUT_MAX_BYTES);
-   frame = iframe;
-   size = isize;
-   memset(bits, 0, sizeof(bits));
-   if (ibits) {
-      memcpy(bits + (offset * isize), ibits, isize);
-   }
-}
-
-void
-GameInput::init(int iframe, char *ibits, int isize)
-{
-   ASSERT(isize);
-   ASSERT(isize <= GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS);
-   frame = iframe;
-   size = isize;
-   memset(bits, 0, sizeof(bits));
-   if (ibits) {
-      memcpy(bits, ibits, isize);
-   }
-}
-
-void
-GameInput::desc(char *buf, size_t buf_size, bool show_frame) const
+template<int MaxBytes, int MaxPlayers> void
+GameInputT<MaxBytes, MaxPlayers>::desc(char *buf, size_t buf_size, bool show_frame) const
 {
    ASSERT(size);
    size_t remaining = buf_size;
@@ -57,32 +31,18 @@ GameInput::desc(char *buf, size_t buf_size, bool show_frame) const
    strncat_s(buf, remaining, ")", 1);
 }
 
-void
-GameInput::log(char *prefix, bool show_frame) const
+template<int MaxBytes, int MaxPlayers> void
+GameInputT<MaxBytes, MaxPlayers>::log(char *prefix, bool show_frame) const
 {
+   if (!LogEnabled(LOG_LEVEL_VERBOSE)) {
+      return;
+   }
 	char buf[1024];
    size_t c = strlen(prefix);
 	strcpy_s(buf, prefix);
 	desc(buf + c, ARRAY_SIZE(buf) - c, show_frame);
    strncat_s(buf, ARRAY_SIZE(buf) - strlen(buf), "\n", 1);
-	Log(buf);
-}
-
-bool
-GameInput::equal(GameInput &other, bool bitsonly)
-{
-   if (!bitsonly && frame != other.frame) {
-      Log("frames don't match: %d, %d\n", frame, other.frame);
-   }
-   if (size != other.size) {
-      Log("sizes don't match: %d, %d\n", size, other.size);
-   }
-   if (memcmp(bits, other.bits, size)) {
-      Log("bits don't match\n");
-   }
-   ASSERT(size && other.size);
-   return (bitsonly || frame == other.frame) &&
-          size == other.size &&
-          memcmp(bits, other.bits, size) == 0;
+	Log("%s", buf);
 }
 
+template struct GameInputT<GAMEINPUT_MAX_BYTES, GAMEINPUT_MAX_PLAYERS>;
@@ -10,31 +10,103 @@
 
 #include <stdio.h>
 #include <memory.h>
+#include "types.h"
 
 // GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS * 8 must be less than
-// 2^BITVECTOR_NIBBLE_SIZE (see bitvector.h)
+// 2^BITVECTOR_NIBBLE_SIZE (see bitvector.h).  Both can be set by the
+// build, but every peer in a session must agree on them.
 
+#ifndef GAMEINPUT_MAX_BYTES
 #define GAMEINPUT_MAX_BYTES      9
+#endif
+#ifndef GAMEINPUT_MAX_PLAYERS
 #define GAMEINPUT_MAX_PLAYERS    2
+#endif
 
-struct GameInput {
+/*
+ * The input for one frame, for up to MaxPlayers players of up to MaxBytes
+ * bytes each.  Every byte past size is kept zeroed, so copies, erase and
+ * equal can all work a whole word at a time over the fixed capacity
+ * rather than a byte at a time over the runtime size.
+ */
+template<int MaxBytes, int MaxPlayers> struct GameInputT
+{
    enum Constants {
-      NullFrame = -1
+      NullFrame = -1,
+      Capacity = MaxBytes * MaxPlayers,
+      Words = (Capacity + sizeof(ggpo::uint32) - 1) / sizeof(ggpo::uint32)
    };
    int      frame;
    int      size; /* size in bytes of the entire input for all players */
-   char     bits[GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS];
+   union {
+      char           bits[Words * sizeof(ggpo::uint32)];
+      ggpo::uint32   words[Words];
+   };
 
    bool is_null() { return frame == NullFrame; }
-   void init(int frame, char *bits, int size, int offset);
-   void init(int frame, char *bits, int size);
    bool value(int i) const { return (bits[i/8] & (1 << (i%8))) != 0; }
    void set(int i) { bits[i/8] |= (1 << (i%8)); }
    void clear(int i) { bits[i/8] &= ~(1 << (i%8)); }
-   void erase() { memset(bits, 0, sizeof(bits)); }
    void desc(char *buf, size_t buf_size, bool show_frame = true) const;
    void log(char *prefix, bool show_frame = true) const;
-   bool equal(GameInput &input, bool bitsonly = false);
+
+   void init(int iframe, char *ibits, int isize, int offset) {
+      ASSERT(isize);
+      ASSERT(isize <= MaxBytes);
+      frame = iframe;
+      size = isize;
+      erase();
+      if (ibits) {
+         memcpy(bits + (offset * isize), ibits, isize);
+      }
+   }
+
+   void init(int iframe, char *ibits, int isize) {
+      ASSERT(isize);
+      ASSERT(isize <= Capacity);
+      frame = iframe;
+      size = isize;
+      erase();
+      if (ibits) {
+         memcpy(bits, ibits, isize);
+      }
+   }
+
+   void erase() {
+      for (int i = 0; i < Words; i++) {
+         words[i] = 0;
+      }
+   }
+
+   /*
+    * Compares only the bits which are set in mask, if there is one.
+    */
+   bool matches(const GameInputT &other, const GameInputT *mask = NULL) const {
+      ggpo::uint32 diff = 0;
+      for (int i = 0; i < Words; i++) {
+         diff |= (words[i] ^ other.words[i]) & (mask ? mask->words[i] : ~0u);
+      }
+      return !diff;
+   }
+
+   bool equal(GameInputT &other, bool bitsonly = false, const GameInputT *mask = NULL) {
+      bool same = matches(other, mask);
+      if (!bitsonly && frame != other.frame) {
+         Log("frames don't match: %d, %d\n", frame, other.frame);
+      }
+      if (size != other.size) {
+         Log("sizes don't match: %d, %d\n", size, other.size);
+      }
+      if (!same) {
+         Log("bits don't match\n");
+      }
+      ASSERT(size && other.size);
+      return (bitsonly || frame == other.frame) &&
+             size == other.size &&
+             same;
+   }
 };
 
+typedef GameInputT<GAMEINPUT_MAX_BYTES, GAMEINPUT_MAX_PLAYERS> GameInput;
+
 #endif
@@ -0,0 +1,97 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#include "types.h"
+#include "input_predictor.h"
+#include "checksum.h"
+
+/*
+ * The per-bit counts are halved whenever one fills up, so the predictor
+ * follows the game as the way the player uses a button changes.
+ */
+#define HOLD_PREDICTOR_MAX_COUNT    255
+
+void
+RepeatPredictor::Predict(const char *, const char *prev, char *guess) const
+{
+   memcpy(guess, prev, _input_size);
+}
+
+void
+HoldPredictor::Init(int input_size)
+{
+   ASSERT(input_size <= GameInput::Capacity);
+   _input_size = input_size;
+   memset(_holds, 0, sizeof(_holds));
+   memset(_flips, 0, sizeof(_flips));
+}
+
+void
+HoldPredictor::Observe(const char *, const char *prev, const char *input)
+{
+   for (int i = 0; i < _input_size * 8; i++) {
+      int was = (prev[i / 8] >> (i % 8)) & 1;
+      int is = (input[i / 8] >> (i % 8)) & 1;
+      ggpo::uint8 *count = (was == is) ? &_holds[i][was] : &_flips[i][was];
+      if (*count == HOLD_PREDICTOR_MAX_COUNT) {
+         _holds[i][was] /= 2;
+         _flips[i][was] /= 2;
+      }
+      (*count)++;
+   }
+}
+
+void
+HoldPredictor::Predict(const char *, const char *prev, char *guess) const
+{
+   memcpy(guess, prev, _input_size);
+   for (int i = 0; i < _input_size * 8; i++) {
+      int was = (prev[i / 8] >> (i % 8)) & 1;
+      if (_flips[i][was] > _holds[i][was]) {
+         guess[i / 8] ^= (1 << (i % 8));
+      }
+   }
+}
+
+void
+HistoryPredictor::Init(int input_size)
+{
+   ASSERT(input_size <= GameInput::Capacity);
+   _input_size = input_size;
+   memset(_entries, 0, sizeof(_entries));
+}
+
+ggpo::uint32
+HistoryPredictor::Hash(const char *older, const char *prev) const
+{
+   char pair[GameInput::Capacity * 2];
+   memcpy(pair, older, _input_size);
+   memcpy(pair + _input_size, prev, _input_size);
+   return Checksum_Crc32c(pair, _input_size * 2);
+}
+
+void
+HistoryPredictor::Observe(const char *older, const char *prev, const char *input)
+{
+   ggpo::uint32 key = Hash(older, prev);
+   Entry *entry = _entries + (key & (HISTORY_PREDICTOR_SLOTS - 1));
+   entry->used = true;
+   entry->key = key;
+   memcpy(entry->next, input, _input_size);
+}
+
+void
+HistoryPredictor::Predict(const char *older, const char *prev, char *guess) const
+{
+   ggpo::uint32 key = Hash(older, prev);
+   const Entry *entry = _entries + (key & (HISTORY_PREDICTOR_SLOTS - 1));
+   if (entry->used && entry->key == key) {
+      memcpy(guess, entry->next, _input_size);
+   } else {
+      memcpy(guess, prev, _input_size);
+   }
+}
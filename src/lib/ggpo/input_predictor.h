@@ -0,0 +1,87 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#ifndef _INPUT_PREDICTOR_H
+#define _INPUT_PREDICTOR_H
+
+#include "types.h"
+#include "game_input.h"
+
+/*
+ * Guesses a player's input for a frame from their input on the two frames
+ * before it.  Either of those may itself be a guess when predicting more
+ * than one frame ahead.  Observe is called with each confirmed input in
+ * order, so predictors which learn can update themselves.  Frames before
+ * the first one are all zeros.
+ */
+class InputPredictor {
+public:
+   virtual ~InputPredictor() { }
+
+   virtual void Init(int input_size) = 0;
+   virtual void Observe(const char *older, const char *prev, const char *input) = 0;
+   virtual void Predict(const char *older, const char *prev, char *guess) const = 0;
+};
+
+/*
+ * The player does whatever they did last.
+ */
+class RepeatPredictor : public InputPredictor {
+public:
+   virtual void Init(int input_size) { _input_size = input_size; }
+   virtual void Observe(const char *, const char *, const char *) { }
+   virtual void Predict(const char *older, const char *prev, char *guess) const;
+
+protected:
+   int         _input_size;
+};
+
+/*
+ * Keeps, for every bit, how often it has stayed the same and how often it
+ * has changed after being on and after being off, and flips bits which
+ * change more often than not.  Repeats the last input for held buttons,
+ * but follows bits which are mashed or dithered every frame.
+ */
+class HoldPredictor : public InputPredictor {
+public:
+   virtual void Init(int input_size);
+   virtual void Observe(const char *older, const char *prev, const char *input);
+   virtual void Predict(const char *older, const char *prev, char *guess) const;
+
+protected:
+   int         _input_size;
+   ggpo::uint8 _holds[GameInput::Capacity * 8][2];
+   ggpo::uint8 _flips[GameInput::Capacity * 8][2];
+};
+
+/*
+ * Remembers what followed each pair of inputs recently seen, and predicts
+ * the same thing will follow them again.  Picks up on short sequences
+ * like combos and rhythmic mashing.  Falls back to repeating the last
+ * input for pairs it hasn't seen.
+ */
+#define HISTORY_PREDICTOR_SLOTS     256     /* must be a power of two */
+
+class HistoryPredictor : public InputPredictor {
+public:
+   virtual void Init(int input_size);
+   virtual void Observe(const char *older, const char *prev, const char *input);
+   virtual void Predict(const char *older, const char *prev, char *guess) const;
+
+protected:
+   ggpo::uint32 Hash(const char *older, const char *prev) const;
+
+   struct Entry {
+      bool           used;
+      ggpo::uint32   key;
+      char           next[GameInput::Capacity];
+   };
+   int         _input_size;
+   Entry       _entries[HISTORY_PREDICTOR_SLOTS];
+};
+
+#endif
@@ -8,40 +8,139 @@
 #include "types.h"
 #include "input_queue.h"
 
-#define PREVIOUS_FRAME(offset)   (((offset) == 0) ? (INPUT_QUEUE_LENGTH - 1) : ((offset) - 1))
-
-InputQueue::InputQueue(int input_size)
+InputQueue::InputQueue(int input_size) :
+   _bits(NULL),
+   _guesses(NULL),
+   _zeros(NULL),
+   _relevance(NULL),
+   _masks(NULL)
 {
+   for (int i = 0; i < GGPO_NUM_INPUT_PREDICTORS; i++) {
+      _predictors[i] = NULL;
+   }
    Init(-1, input_size);
 }
 
 InputQueue::~InputQueue()
 {
+   for (int i = 0; i < GGPO_NUM_INPUT_PREDICTORS; i++) {
+      delete _predictors[i];
+   }
+   delete [] _bits;
+   delete [] _guesses;
+   delete [] _zeros;
+   delete [] _relevance;
+   delete [] _masks;
 }
 
 void
 InputQueue::Init(int id, int input_size)
 {
    _id = id;
-   _head = 0;
-   _tail = 0;
-   _length = 0;
+   _input_size = input_size;
+   _first_queued_frame = 0;
    _frame_delay = 0;
-   _first_frame = true;
    _last_user_added_frame = GameInput::NullFrame;
    _first_incorrect_frame = GameInput::NullFrame;
    _last_frame_requested = GameInput::NullFrame;
    _last_added_frame = GameInput::NullFrame;
+   _incorrect_inputs = 0;
 
    _prediction.init(GameInput::NullFrame, NULL, input_size);
 
    /*
-    * This is safe because we know the GameInput is a proper structure (as in,
-    * no virtual methods, no contained classes, etc.).
+    * Only the input bits are stored.  Frames go in one after another
+    * starting at 0, so the input for a frame always lands in the same
+    * slot and there's no need to store its frame number.
     */
-   memset(_inputs, 0, sizeof _inputs);
-   for (int i = 0; i < ARRAY_SIZE(_inputs); i++) {
-      _inputs[i].size = input_size;
+   delete [] _bits;
+   _bits = new char[INPUT_QUEUE_LENGTH * input_size];
+   memset(_bits, 0, INPUT_QUEUE_LENGTH * input_size);
+
+   _predictor = GGPO_PREDICT_REPEAT;
+   _compare_predictors = false;
+   for (int i = 0; i < GGPO_NUM_INPUT_PREDICTORS; i++) {
+      delete _predictors[i];
+      _predictors[i] = NULL;
+   }
+   CreatePredictors();
+   _last_predicted_frame = GameInput::NullFrame;
+   memset(&_prediction_stats, 0, sizeof(_prediction_stats));
+   memset(&_misprediction_stats, 0, sizeof(_misprediction_stats));
+
+   delete [] _zeros;
+   _zeros = new char[input_size];
+   memset(_zeros, 0, input_size);
+
+   delete [] _relevance;
+   _relevance = new char[input_size];
+   delete [] _masks;
+   _masks = new char[INPUT_QUEUE_LENGTH * input_size];
+   SetRelevance(NULL);
+}
+
+void
+InputQueue::SetPredictor(GGPOInputPredictor predictor)
+{
+   _predictor = predictor;
+   CreatePredictors();
+}
+
+/*
+ * Runs every predictor alongside the selected one, so GetPredictionStats
+ * can say how each would have done.  Costs a prediction and an update per
+ * predictor on every frame, so it's off unless asked for.
+ */
+void
+InputQueue::SetPredictorComparison(bool enable)
+{
+   _compare_predictors = enable;
+   CreatePredictors();
+}
+
+/*
+ * Makes sure the predictors which are needed exist and the rest don't,
+ * and sizes the guesses to match.  Only called before any input has
+ * been predicted, so there's nothing to carry over.
+ */
+void
+InputQueue::CreatePredictors()
+{
+   for (int i = 0; i < GGPO_NUM_INPUT_PREDICTORS; i++) {
+      bool needed = _compare_predictors || i == _predictor;
+      if (needed && !_predictors[i]) {
+         switch (i) {
+         case GGPO_PREDICT_HOLD:    _predictors[i] = new HoldPredictor(); break;
+         case GGPO_PREDICT_HISTORY: _predictors[i] = new HistoryPredictor(); break;
+         default:                   _predictors[i] = new RepeatPredictor(); break;
+         }
+         _predictors[i]->Init(_input_size);
+      } else if (!needed && _predictors[i]) {
+         delete _predictors[i];
+         _predictors[i] = NULL;
+      }
+      _first_missed_frame[i] = GameInput::NullFrame;
+   }
+
+   int count = _compare_predictors ? GGPO_NUM_INPUT_PREDICTORS : 1;
+   delete [] _guesses;
+   _guesses = new char[count * INPUT_QUEUE_LENGTH * _input_size];
+}
+
+/*
+ * Mispredicted bits which aren't set in mask don't count as errors, so
+ * the game can say which of its inputs don't affect the simulation at
+ * the moment.  The mask is remembered with each frame as it's predicted,
+ * so changing it doesn't affect frames which have already been run.
+ * NULL makes every bit relevant again.
+ */
+void
+InputQueue::SetRelevance(const char *mask)
+{
+   if (mask) {
+      memcpy(_relevance, mask, _input_size);
+   } else {
+      memset(_relevance, 0xff, _input_size);
    }
 }
 
@@ -67,22 +166,21 @@ InputQueue::DiscardConfirmedFrames(int frame)
       frame = MIN(frame, _last_frame_requested);
    }
 
-   Log("discarding confirmed frames up to %d (last_added:%d length:%d [head:%d tail:%d]).\n", 
-       frame, _last_added_frame, _length, _head, _tail);
+   Log("discarding confirmed frames up to %d (last_added:%d length:%d [first queued:%d]).\n", 
+       frame, _last_added_frame, GetLength(), _first_queued_frame);
    if (frame >= _last_added_frame) {
-      _tail = _head;
+      _first_queued_frame = _last_added_frame + 1;
    } else {
-      int offset = frame - _inputs[_tail].frame + 1;
+      int offset = frame - _first_queued_frame + 1;
       
       Log("difference of %d frames.\n", offset);
       ASSERT(offset >= 0);
 
-      _tail = (_tail + offset) % INPUT_QUEUE_LENGTH;
-      _length -= offset;
+      _first_queued_frame += offset;
    }
 
-   Log("after discarding, new tail is %d (frame:%d).\n", _tail, _inputs[_tail].frame);
-   ASSERT(_length >= 0);
+   Log("after discarding, new first queued frame is %d.\n", _first_queued_frame);
+   ASSERT(GetLength() >= 0);
 }
 
 void
@@ -99,18 +197,37 @@ InputQueue::ResetPrediction(int frame)
    _prediction.frame = GameInput::NullFrame;
    _first_incorrect_frame = GameInput::NullFrame;
    _last_frame_requested = GameInput::NullFrame;
+   _last_predicted_frame = GameInput::NullFrame;
+   for (int i = 0; i < GGPO_NUM_INPUT_PREDICTORS; i++) {
+      _first_missed_frame[i] = GameInput::NullFrame;
+   }
 }
 
-bool
-InputQueue::GetConfirmedInput(int requested_frame, GameInput *input)
+/*
+ * Copies the input for count frames starting at first into dest, one
+ * frame every stride bytes, and returns how many were copied.  Stops
+ * early at the first frame we haven't received.
+ */
+int
+InputQueue::GetConfirmedInputs(int first, int count, char *dest, int stride)
 {
-   ASSERT(_first_incorrect_frame == GameInput::NullFrame || requested_frame < _first_incorrect_frame);
-   int offset = requested_frame % INPUT_QUEUE_LENGTH; 
-   if (_inputs[offset].frame != requested_frame) {
-      return false;
+   /*
+    * Frames stay readable after being discarded until their slot is
+    * reused.
+    */
+   if (first < 0 || first <= _last_added_frame - INPUT_QUEUE_LENGTH) {
+      return 0;
    }
-   *input = _inputs[offset];
-   return true;
+   count = MIN(count, _last_added_frame - first + 1);
+   if (count <= 0) {
+      return 0;
+   }
+   ASSERT(_first_incorrect_frame == GameInput::NullFrame || first + count <= _first_incorrect_frame);
+
+   for (int i = 0; i < count; i++) {
+      memcpy(dest + (i * stride), GetBits(first + i), _input_size);
+   }
+   return count;
 }
 
 bool
@@ -131,56 +248,174 @@ InputQueue::GetInput(int requested_frame, GameInput *input)
     */
    _last_frame_requested = requested_frame;
 
-   ASSERT(requested_frame >= _inputs[_tail].frame);
+   ASSERT(requested_frame >= _first_queued_frame);
 
    if (_prediction.frame == GameInput::NullFrame) {
       /*
        * If the frame requested is in our range, fetch it out of the queue and
        * return it.
        */
-      int offset = requested_frame - _inputs[_tail].frame;
-
-      if (offset < _length) {
-         offset = (offset + _tail) % INPUT_QUEUE_LENGTH;
-         ASSERT(_inputs[offset].frame == requested_frame);
-         *input = _inputs[offset];
+      if (requested_frame <= _last_added_frame) {
+         ReadInput(requested_frame, input);
          Log("returning confirmed frame number %d.\n", input->frame);
          return true;
       }
 
       /*
        * The requested frame isn't in the queue.  Bummer.  This means we need
-       * to return a prediction frame.  Predict that the user will do the
-       * same thing they did last time.
+       * to return a prediction frame, starting with the one after the last
+       * frame we have.
        */
-      if (requested_frame == 0) {
-         Log("basing new prediction frame from nothing, you're client wants frame 0.\n");
-         _prediction.erase();
-      } else if (_last_added_frame == GameInput::NullFrame) {
-         Log("basing new prediction frame from nothing, since we have no frames yet.\n");
-         _prediction.erase();
-      } else {
-         Log("basing new prediction frame from previously added frame (queue entry:%d, frame:%d).\n",
-              PREVIOUS_FRAME(_head), _inputs[PREVIOUS_FRAME(_head)].frame);
-         _prediction = _inputs[PREVIOUS_FRAME(_head)];
-      }
-      _prediction.frame++;
+      Log("basing new prediction frame from previously added frame (frame:%d).\n", _last_added_frame);
+      _prediction.frame = _last_added_frame + 1;
    }
 
    ASSERT(_prediction.frame >= 0);
+   ASSERT(requested_frame - _last_added_frame < INPUT_QUEUE_LENGTH);
 
    /*
-    * If we've made it this far, we must be predicting.  Go ahead and
-    * forward the prediction frame contents.  Be sure to return the
-    * frame number requested by the client, though.
+    * If we've made it this far, we must be predicting.  Guess any frames
+    * up to the requested one which haven't been yet, and hand back the
+    * guess of the selected predictor.
     */
-   *input = _prediction;
-   input->frame = requested_frame;
+   for (int frame = MAX(_last_predicted_frame, _last_added_frame) + 1; frame <= requested_frame; frame++) {
+      PredictFrame(frame);
+      memcpy(GetMask(frame), _relevance, _input_size);
+      _predicted_from[frame & INPUT_QUEUE_MASK] = _last_added_frame;
+      _last_predicted_frame = frame;
+   }
+   input->init(requested_frame, GetGuess(_predictor, requested_frame), _input_size);
    Log("returning prediction frame number %d (%d).\n", input->frame, _prediction.frame);
 
    return false;
 }
 
+/*
+ * The input for frame as predictor sees it: the real input if we have it,
+ * otherwise its guess.
+ */
+const char *
+InputQueue::GetHistory(int predictor, int frame)
+{
+   if (frame < 0) {
+      return _zeros;
+   }
+   if (frame <= _last_added_frame) {
+      return GetBits(frame);
+   }
+   return GetGuess(predictor, frame);
+}
+
+void
+InputQueue::PredictFrame(int frame)
+{
+   for (int i = 0; i < GGPO_NUM_INPUT_PREDICTORS; i++) {
+      if (_predictors[i]) {
+         _predictors[i]->Predict(GetHistory(i, frame - 2), GetHistory(i, frame - 1), GetGuess(i, frame));
+      }
+   }
+}
+
+/*
+ * Checks every predictor's guess for a frame the game was run on against
+ * the real input.  A predictor's first miss in a run of predictions is
+ * where it would have had to roll back to, re-running every frame up to
+ * the last one requested.  Only the bits which were relevant to the frame
+ * are checked.
+ */
+void
+InputQueue::ScorePredictions(int frame, GameInput &input)
+{
+   GameInput guess, mask;
+   mask.init(frame, GetMask(frame), _input_size);
+
+   _prediction_stats.frames_predicted++;
+   for (int i = 0; i < GGPO_NUM_INPUT_PREDICTORS; i++) {
+      if (!_predictors[i]) {
+         continue;
+      }
+      guess.init(frame, GetGuess(i, frame), _input_size);
+      if (guess.matches(input, &mask)) {
+         _prediction_stats.frames_correct[i]++;
+      } else if (_first_missed_frame[i] == GameInput::NullFrame) {
+         _first_missed_frame[i] = frame;
+         _prediction_stats.rollbacks[i]++;
+         _prediction_stats.rollback_frames[i] += _last_frame_requested - frame + 1;
+      }
+   }
+}
+
+/*
+ * Returns the input GetInput would for requested_frame right after a
+ * ResetPrediction, without changing any state.  Returns false if the
+ * frame has already been discarded.
+ */
+bool
+InputQueue::PeekInput(int requested_frame, GameInput *input)
+{
+   if (requested_frame < _first_queued_frame) {
+      return false;
+   }
+   if (requested_frame <= _last_added_frame) {
+      ReadInput(requested_frame, input);
+      return true;
+   }
+
+   /*
+    * Run the selected predictor forward from the last frame we have,
+    * keeping the guesses to one side.
+    */
+   GameInput guesses[3];
+   for (int frame = _last_added_frame + 1; frame <= requested_frame; frame++) {
+      const char *older = (frame - 2 > _last_added_frame) ? guesses[(frame - 2) % 3].bits : GetHistory(_predictor, frame - 2);
+      const char *prev = (frame - 1 > _last_added_frame) ? guesses[(frame - 1) % 3].bits : GetHistory(_predictor, frame - 1);
+      _predictors[_predictor]->Predict(older, prev, guesses[frame % 3].bits);
+   }
+   input->init(requested_frame, guesses[requested_frame % 3].bits, _input_size);
+   return true;
+}
+
+/*
+ * Fills in up to max of the most recent distinct inputs other than the
+ * last one added, most recent first, followed by an empty input if there's
+ * room.  These are the likeliest things for the player to switch to next.
+ */
+int
+InputQueue::GetRecentInputs(GameInput *inputs, int max)
+{
+   if (_last_added_frame == GameInput::NullFrame) {
+      return 0;
+   }
+
+   GameInput latest;
+   ReadInput(_last_added_frame, &latest);
+   int count = 0;
+   for (int frame = _last_added_frame - 1; frame >= 0 && frame > _last_added_frame - INPUT_QUEUE_LENGTH && count < max; frame--) {
+      GameInput input;
+      ReadInput(frame, &input);
+      bool seen = latest.equal(input, true);
+      for (int j = 0; j < count && !seen; j++) {
+         seen = inputs[j].equal(input, true);
+      }
+      if (!seen) {
+         inputs[count++] = input;
+      }
+   }
+
+   if (count < max) {
+      GameInput empty = latest;
+      empty.erase();
+      bool seen = latest.equal(empty, true);
+      for (int j = 0; j < count && !seen; j++) {
+         seen = inputs[j].equal(empty, true);
+      }
+      if (!seen) {
+         inputs[count++] = empty;
+      }
+   }
+   return count;
+}
+
 void
 InputQueue::AddInput(GameInput &input)
 {
@@ -213,6 +448,43 @@ InputQueue::AddInput(GameInput &input)
    input.frame = new_frame;
 }
 
+/*
+ * Adds a misprediction which is about to cause a rollback to the
+ * telemetry.  How deep the rollback goes isn't known until it runs; see
+ * RecordRollback.
+ */
+void
+InputQueue::RecordMisprediction(int frame, GameInput &guess, GameInput &input, GameInput &mask)
+{
+   int ahead = frame - _predicted_from[frame & INPUT_QUEUE_MASK];
+
+   Log("misprediction at frame %d was %d frames ahead.\n", frame, ahead);
+
+   _misprediction_stats.mispredictions++;
+   for (int i = 0; i < _input_size * 8 && i < GGPO_MAX_INPUT_BITS; i++) {
+      if (mask.value(i) && guess.value(i) != input.value(i)) {
+         _misprediction_stats.bits[i]++;
+      }
+   }
+   ASSERT(ahead >= 1);
+   _misprediction_stats.frames_ahead[MIN(ahead, GGPO_MAX_PREDICTION_FRAMES) - 1]++;
+}
+
+/*
+ * Adds the number of frames the rollback for our last misprediction
+ * re-ran to the telemetry.  That's counted from the frame Sync actually
+ * loaded, which may be a keyframe before the misprediction, and the
+ * rollback may have been shared with other players' mispredictions.
+ */
+void
+InputQueue::RecordRollback(int depth)
+{
+   Log("rolled back %d frames.\n", depth);
+   if (depth >= 1) {
+      _misprediction_stats.rollback_depth[MIN(depth, GGPO_MAX_PREDICTION_FRAMES) - 1]++;
+   }
+}
+
 void
 InputQueue::AddDelayedInputToQueue(GameInput &input, int frame_number)
 {
@@ -222,17 +494,32 @@ InputQueue::AddDelayedInputToQueue(GameInput &input, int frame_number)
 
    ASSERT(_last_added_frame == GameInput::NullFrame || frame_number == _last_added_frame + 1);
 
-   ASSERT(frame_number == 0 || _inputs[PREVIOUS_FRAME(_head)].frame == frame_number - 1);
+   /*
+    * Once a prediction error has been found, later inputs aren't checked
+    * against the prediction any more.  Count the ones which would have
+    * caused another rollback had the first been handled right away, i.e.
+    * the ones for frames which have already been run that differ from the
+    * input before them.
+    */
+   if (_first_incorrect_frame != GameInput::NullFrame &&
+       frame_number <= _last_frame_requested &&
+       memcmp(GetBits(frame_number - 1), input.bits, _input_size)) {
+      _incorrect_inputs++;
+   }
+
+   if (frame_number <= _last_predicted_frame) {
+      ScorePredictions(frame_number, input);
+   }
+   for (int i = 0; i < GGPO_NUM_INPUT_PREDICTORS; i++) {
+      if (_predictors[i]) {
+         _predictors[i]->Observe(GetHistory(i, frame_number - 2), GetHistory(i, frame_number - 1), input.bits);
+      }
+   }
 
    /*
     * Add the frame to the back of the queue
     */ 
-   _inputs[_head] = input;
-   _inputs[_head].frame = frame_number;
-   _head = (_head + 1) % INPUT_QUEUE_LENGTH;
-   _length++;
-   _first_frame = false;
-
+   memcpy(GetBits(frame_number), input.bits, _input_size);
    _last_added_frame = frame_number;
 
    if (_prediction.frame != GameInput::NullFrame) {
@@ -244,9 +531,17 @@ InputQueue::AddDelayedInputToQueue(GameInput &input, int frame_number)
        * remember the first input which was incorrect so we can report it
        * in GetFirstIncorrectFrame()
        */
-      if (_first_incorrect_frame == GameInput::NullFrame && !_prediction.equal(input, true)) {
-         Log("frame %d does not match prediction.  marking error.\n", frame_number);
-         _first_incorrect_frame = frame_number;
+      if (_first_incorrect_frame == GameInput::NullFrame) {
+         ASSERT(frame_number <= _last_predicted_frame);
+         GameInput guess, mask;
+         guess.init(frame_number, GetGuess(_predictor, frame_number), _input_size);
+         mask.init(frame_number, GetMask(frame_number), _input_size);
+         if (!guess.equal(input, true, &mask)) {
+            Log("frame %d does not match prediction.  marking error.\n", frame_number);
+            _first_incorrect_frame = frame_number;
+            _incorrect_inputs++;
+            RecordMisprediction(frame_number, guess, input, mask);
+         }
       }
 
       /*
@@ -258,11 +553,15 @@ InputQueue::AddDelayedInputToQueue(GameInput &input, int frame_number)
       if (_prediction.frame == _last_frame_requested && _first_incorrect_frame == GameInput::NullFrame) {
          Log("prediction is correct!  dumping out of prediction mode.\n");
          _prediction.frame = GameInput::NullFrame;
+         _last_predicted_frame = GameInput::NullFrame;
+         for (int i = 0; i < GGPO_NUM_INPUT_PREDICTORS; i++) {
+            _first_missed_frame[i] = GameInput::NullFrame;
+         }
       } else {
          _prediction.frame++;
       }
    }
-   ASSERT(_length <= INPUT_QUEUE_LENGTH);
+   ASSERT(GetLength() <= INPUT_QUEUE_LENGTH);
 }
 
 int
@@ -270,7 +569,7 @@ InputQueue::AdvanceQueueHead(int frame)
 {
    Log("advancing queue head to frame %d.\n", frame);
 
-   int expected_frame = _first_frame ? 0 : _inputs[PREVIOUS_FRAME(_head)].frame + 1;
+   int expected_frame = (_last_added_frame == GameInput::NullFrame) ? 0 : _last_added_frame + 1;
 
    frame += _frame_delay;
 
@@ -294,27 +593,23 @@ InputQueue::AdvanceQueueHead(int frame)
        */
       Log("Adding padding frame %d to account for change in frame delay.\n",
           expected_frame);
-      GameInput &last_frame = _inputs[PREVIOUS_FRAME(_head)];     
+      GameInput last_frame;
+      ReadInput(expected_frame - 1, &last_frame);
       AddDelayedInputToQueue(last_frame, expected_frame);
       expected_frame++;
    }
 
-   ASSERT(frame == 0 || frame == _inputs[PREVIOUS_FRAME(_head)].frame + 1);
+   ASSERT(frame == 0 || frame == _last_added_frame + 1);
    return frame;
 }
 
 
 void
-InputQueue::Log(const char *fmt, ...)
+InputQueue::LogWrite(const char *fmt, ...)
 {
-   char buf[1024];
-   size_t offset;
    va_list args;
 
-   offset = sprintf_s(buf, ARRAY_SIZE(buf), "input q%d | ", _id);
    va_start(args, fmt);
-   vsnprintf(buf + offset, ARRAY_SIZE(buf) - offset - 1, fmt, args);
-   buf[ARRAY_SIZE(buf)-1] = '\0';
-   ::Log(buf);
+   Logv("input q%d | ", _id, fmt, args);
    va_end(args);
 }
@@ -8,9 +8,12 @@
 #ifndef _INPUT_QUEUE_H
 #define _INPUT_QUEUE_H
 
+#include "ggponet.h"
 #include "game_input.h"
+#include "input_predictor.h"
 
-#define INPUT_QUEUE_LENGTH    128
+#define INPUT_QUEUE_LENGTH    128      /* must be a power of two */
+#define INPUT_QUEUE_MASK      (INPUT_QUEUE_LENGTH - 1)
 #define DEFAULT_INPUT_SIZE      4
 
 class InputQueue {
@@ -22,36 +25,71 @@ public:
    void Init(int id, int input_size);
    int GetLastConfirmedFrame();
    int GetFirstIncorrectFrame();
-   int GetLength() { return _length; }
+   int GetIncorrectInputCount() { return _incorrect_inputs; }
+   int GetLength() { return _last_added_frame - _first_queued_frame + 1; }
 
    void SetFrameDelay(int delay) { _frame_delay = delay; }
+   void SetPredictor(GGPOInputPredictor predictor);
+   void SetPredictorComparison(bool enable);
+   void SetRelevance(const char *mask);
+   void GetPredictionStats(GGPOPredictionStats *stats) { *stats = _prediction_stats; }
+   void GetMispredictionStats(GGPOMispredictionStats *stats) { *stats = _misprediction_stats; }
    void ResetPrediction(int frame);
+   void RecordRollback(int depth);
    void DiscardConfirmedFrames(int frame);
-   bool GetConfirmedInput(int frame, GameInput *input);
+   int GetConfirmedInputs(int first, int count, char *dest, int stride);
    bool GetInput(int frame, GameInput *input);
+   bool PeekInput(int frame, GameInput *input);
+   int GetRecentInputs(GameInput *inputs, int max);
    void AddInput(GameInput &input);
 
 protected:
    int AdvanceQueueHead(int frame);
+   char *GetBits(int frame) { return _bits + ((frame & INPUT_QUEUE_MASK) * _input_size); }
+   void ReadInput(int frame, GameInput *input) { input->init(frame, GetBits(frame), _input_size); }
+   char *GetGuess(int predictor, int frame) { return _guesses + (((_compare_predictors ? predictor : 0) * INPUT_QUEUE_LENGTH + (frame & INPUT_QUEUE_MASK)) * _input_size); }
+   char *GetMask(int frame) { return _masks + ((frame & INPUT_QUEUE_MASK) * _input_size); }
+   const char *GetHistory(int predictor, int frame);
+   void CreatePredictors();
+   void PredictFrame(int frame);
+   void ScorePredictions(int frame, GameInput &input);
+   void RecordMisprediction(int frame, GameInput &guess, GameInput &input, GameInput &mask);
    void AddDelayedInputToQueue(GameInput &input, int i);
-   void Log(const char *fmt, ...);
+   void LogWrite(const char *fmt, ...);
 
 protected:
    int                  _id;
-   int                  _head;
-   int                  _tail;
-   int                  _length;
-   bool                 _first_frame;
+   int                  _input_size;
+   int                  _first_queued_frame;
 
    int                  _last_user_added_frame;
    int                  _last_added_frame;
    int                  _first_incorrect_frame;
    int                  _last_frame_requested;
+   int                  _incorrect_inputs;
 
    int                  _frame_delay;
 
-   GameInput            _inputs[INPUT_QUEUE_LENGTH];
+   char                 *_bits;          /* the input for frame n is at GetBits(n) */
    GameInput            _prediction;
+
+   /*
+    * The game is given the guesses of _predictor, and normally it's the
+    * only one which exists.  With comparison on, every predictor guesses
+    * every predicted frame, so their hit rates can be compared.
+    */
+   GGPOInputPredictor   _predictor;
+   bool                 _compare_predictors;
+   InputPredictor       *_predictors[GGPO_NUM_INPUT_PREDICTORS];  /* NULL for those not running */
+   char                 *_guesses;       /* predictor p's guess for frame n is at GetGuess(p, n) */
+   char                 *_zeros;         /* the input for frames before 0 */
+   char                 *_relevance;     /* the bits which matter to frames predicted from now on */
+   char                 *_masks;         /* the relevant bits of predicted frame n are at GetMask(n) */
+   int                  _last_predicted_frame;
+   int                  _predicted_from[INPUT_QUEUE_LENGTH]; /* the last frame we had when frame n was guessed */
+   int                  _first_missed_frame[GGPO_NUM_INPUT_PREDICTORS];
+   GGPOPredictionStats  _prediction_stats;
+   GGPOMispredictionStats _misprediction_stats;
 };
 
 #endif
@@ -6,41 +6,99 @@
  */
 
 #include "types.h"
+#include "config.h"
+#include "trace.h"
 
 static FILE *logfile = NULL;
+static bool flush_on_log = true;
 
 void LogFlush()
 {
+   if (log_trace) {
+      TraceDump();
+   }
    if (logfile) {
       fflush(logfile);
    }
 }
 
-static char logbuf[4 * 1024 * 1024];
+void LogFlushOnLog(bool flush)
+{
+   flush_on_log = flush;
+}
+
+int log_level = -1;
+bool log_trace = false;
 
-void Log(const char *fmt, ...)
+int LogInitLevel()
+{
+   static bool dump_at_exit = false;
+
+   ConfigLoad();
+   log_trace = false;
+   if (!ggpo_config.log || ggpo_config.log_ignore) {
+      log_level = LOG_LEVEL_NONE;
+   } else {
+      log_level = ggpo_config.log_level;
+      if (log_level <= LOG_LEVEL_NONE || log_level > LOG_LEVEL_VERBOSE) {
+         log_level = LOG_LEVEL_VERBOSE;
+      }
+      log_trace = ggpo_config.log_trace;
+      if (log_trace && !dump_at_exit) {
+         dump_at_exit = true;
+         atexit(TraceDump);
+      }
+   }
+   return log_level;
+}
+
+void LogWrite(const char *fmt, ...)
 {
    va_list args;
    va_start(args, fmt);
-   Logv(fmt, args);
+   Logv(NULL, 0, fmt, args);
    va_end(args);
 }
 
-void Logv(const char *fmt, va_list args)
+void Logv(const char *prefix, int id, const char *fmt, va_list args)
 {
-   if (!Platform::GetConfigBool("ggpo.log") || Platform::GetConfigBool("ggpo.log.ignore")) {
+   if (LogGetLevel() == LOG_LEVEL_NONE) {
+      return;
+   }
+   if (log_trace) {
+      TraceRecordv(prefix, id, fmt, args);
       return;
    }
    if (!logfile) {
-      sprintf_s(logbuf, ARRAY_SIZE(logbuf), "log-%d.log", Platform::GetProcessID());
-      fopen_s(&logfile, logbuf, "w");
+      char filename[64];
+      sprintf_s(filename, ARRAY_SIZE(filename), "log-%d.log", Platform::GetProcessID());
+      fopen_s(&logfile, filename, "w");
    }
-   Logv(logfile, fmt, args);
+   Logv(logfile, prefix, id, fmt, args);
 }
 
-void Logv(FILE *fp, const char *fmt, va_list args)
+/*
+ * For formats which may not outlive the call, like the ones the game
+ * passes to ggpo_log.  Trace mode records the formatted text instead.
+ */
+void Logv(const char *fmt, va_list args)
 {
-   if (Platform::GetConfigBool("ggpo.log.timestamps")) {
+   if (LogGetLevel() == LOG_LEVEL_NONE) {
+      return;
+   }
+   if (log_trace) {
+      char buf[1024];
+      vsnprintf(buf, ARRAY_SIZE(buf) - 1, fmt, args);
+      buf[ARRAY_SIZE(buf)-1] = '\0';
+      LogWrite("%s", buf);
+      return;
+   }
+   Logv(NULL, 0, fmt, args);
+}
+
+void Logv(FILE *fp, const char *prefix, int id, const char *fmt, va_list args)
+{
+   if (ggpo_config.log_timestamps) {
       static int start = 0;
       int t = 0;
       if (!start) {
@@ -51,9 +109,11 @@ void Logv(FILE *fp, const char *fmt, va_list args)
       fprintf(fp, "%d.%03d : ", t / 1000, t % 1000);
    }
 
+   if (prefix) {
+      fprintf(fp, prefix, id);
+   }
    vfprintf(fp, fmt, args);
-   fflush(fp);
-   
-   vsprintf_s(logbuf, ARRAY_SIZE(logbuf), fmt, args);
+   if (flush_on_log) {
+      fflush(fp);
+   }
 }
-
@@ -8,9 +8,53 @@
 #ifndef _LOG_H
 #define _LOG_H
 
-extern void Log(const char *fmt, ...);
+#define LOG_LEVEL_NONE           0
+#define LOG_LEVEL_ERROR          1
+#define LOG_LEVEL_WARNING        2
+#define LOG_LEVEL_INFO           3
+#define LOG_LEVEL_VERBOSE        4
+
+/*
+ * Messages above GGPO_LOG_LEVEL are compiled out, arguments and all.
+ * Build with GGPO_LOG_LEVEL=0 to strip logging from the library.
+ */
+#ifndef GGPO_LOG_LEVEL
+#define GGPO_LOG_LEVEL           LOG_LEVEL_VERBOSE
+#endif
+
+/*
+ * The level set at runtime, worked out from the ggpo.log, ggpo.log.ignore
+ * and ggpo.log.level settings (see config.h) the first time it's needed.  ggpo.log
+ * turns logging on at LOG_LEVEL_VERBOSE unless ggpo.log.level says
+ * otherwise.  ggpo.log.trace sends messages to the binary trace rings
+ * (see trace.h) instead of the log file.
+ */
+extern int log_level;
+extern int LogInitLevel();
+inline int LogGetLevel() { return log_level >= 0 ? log_level : LogInitLevel(); }
+
+#define LogEnabled(level)        ((level) <= GGPO_LOG_LEVEL && (level) <= LogGetLevel())
+
+/*
+ * Everything logs through these, so nothing is formatted unless the
+ * message will be written.  They call whichever LogWrite is in scope,
+ * so classes can add a prefix to their messages by declaring their own
+ * which passes the prefix to Logv.
+ *
+ * In trace mode (ggpo.log.trace) messages are recorded by address rather
+ * than formatted, so fmt and any prefix must be string literals.
+ */
+#define LogError(...)            (LogEnabled(LOG_LEVEL_ERROR) ? LogWrite(__VA_ARGS__) : (void)0)
+#define LogWarning(...)          (LogEnabled(LOG_LEVEL_WARNING) ? LogWrite(__VA_ARGS__) : (void)0)
+#define LogInfo(...)             (LogEnabled(LOG_LEVEL_INFO) ? LogWrite(__VA_ARGS__) : (void)0)
+#define Log(...)                 (LogEnabled(LOG_LEVEL_VERBOSE) ? LogWrite(__VA_ARGS__) : (void)0)
+
+extern bool log_trace;
+
+extern void LogWrite(const char *fmt, ...);
+extern void Logv(const char *prefix, int id, const char *fmt, va_list args);
 extern void Logv(const char *fmt, va_list list);
-extern void Logv(FILE *fp, const char *fmt, va_list args);
+extern void Logv(FILE *fp, const char *prefix, int id, const char *fmt, va_list args);
 extern void LogFlush();
 extern void LogFlushOnLog(bool flush);
 
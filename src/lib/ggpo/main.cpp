@@ -6,6 +6,8 @@
  */
 
 #include "types.h"
+#include "checksum.h"
+#include "config.h"
 #include "backends/p2p.h"
 #include "backends/synctest.h"
 #include "backends/spectator.h"
@@ -43,6 +45,7 @@ ggpo_start_session(GGPOSession **session,
                    int input_size,
                    unsigned short localport)
 {
+   ConfigLoad();
    *session= (GGPOSession *)new Peer2PeerBackend(cb,
                                                  game,
                                                  localport,
@@ -72,6 +75,7 @@ ggpo_start_synctest(GGPOSession **ggpo,
                     int input_size,
                     int frames)
 {
+   ConfigLoad();
    *ggpo = (GGPOSession *)new SyncTestBackend(cb, game, frames, num_players);
    return GGPO_OK;
 }
@@ -187,6 +191,165 @@ ggpo_set_disconnect_notify_start(GGPOSession *ggpo, int timeout)
    return ggpo->SetDisconnectNotifyStart(timeout);
 }
 
+GGPOErrorCode
+ggpo_set_prediction_window(GGPOSession *ggpo, int frames)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->SetPredictionWindow(frames);
+}
+
+GGPOErrorCode
+ggpo_set_keyframe_interval(GGPOSession *ggpo, int interval)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->SetKeyframeInterval(interval);
+}
+
+GGPOErrorCode
+ggpo_set_rollback_coalescing(GGPOSession *ggpo, bool enable)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->SetRollbackCoalescing(enable);
+}
+
+GGPOErrorCode
+ggpo_set_rollback_budget(GGPOSession *ggpo, int budget)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->SetRollbackBudget(budget);
+}
+
+GGPOErrorCode
+ggpo_set_snapshot_arena(GGPOSession *ggpo, int state_size)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->SetSnapshotArena(state_size);
+}
+
+GGPOErrorCode
+ggpo_set_snapshot_mode(GGPOSession *ggpo, GGPOSnapshotMode mode)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->SetSnapshotMode(mode);
+}
+
+GGPOErrorCode
+ggpo_set_snapshot_region(GGPOSession *ggpo, void *state, int size)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->SetSnapshotRegion(state, size);
+}
+
+GGPOErrorCode
+ggpo_set_background_saves(GGPOSession *ggpo, bool enable)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->SetBackgroundSaves(enable);
+}
+
+GGPOErrorCode
+ggpo_set_speculation(GGPOSession *ggpo, int branches)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->SetSpeculation(branches);
+}
+
+GGPOErrorCode
+ggpo_set_input_predictor(GGPOSession *ggpo, GGPOInputPredictor predictor)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->SetInputPredictor(predictor);
+}
+
+GGPOErrorCode
+ggpo_set_predictor_comparison(GGPOSession *ggpo, bool enable)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->SetPredictorComparison(enable);
+}
+
+GGPOErrorCode
+ggpo_set_receive_thread(GGPOSession *ggpo, bool enable)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->SetReceiveThread(enable);
+}
+
+GGPOErrorCode
+ggpo_set_input_relevance(GGPOSession *ggpo, GGPOPlayerHandle player, void *mask, int size)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->SetInputRelevance(player, mask, size);
+}
+
+GGPOErrorCode
+ggpo_get_snapshot_stats(GGPOSession *ggpo, GGPOSnapshotStats *stats)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->GetSnapshotStats(stats);
+}
+
+GGPOErrorCode
+ggpo_get_prediction_stats(GGPOSession *ggpo, GGPOPlayerHandle player, GGPOPredictionStats *stats)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->GetPredictionStats(player, stats);
+}
+
+GGPOErrorCode
+ggpo_get_misprediction_stats(GGPOSession *ggpo, GGPOPlayerHandle player, GGPOMispredictionStats *stats)
+{
+   if (!ggpo) {
+      return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   return ggpo->GetMispredictionStats(player, stats);
+}
+
+int
+ggpo_checksum(const void *buffer, int len)
+{
+   return (int)Checksum_Crc32c(buffer, len);
+}
+
+GGPOErrorCode
+ggpo_set_config(const char *name, int value)
+{
+   if (!name || !ConfigSet(name, value)) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   return GGPO_OK;
+}
+
 GGPOErrorCode ggpo_start_spectating(GGPOSession **session,
                                     GGPOSessionCallbacks *cb,
                                     const char *game,
@@ -196,6 +359,7 @@ GGPOErrorCode ggpo_start_spectating(GGPOSession **session,
                                     char *host_ip,
                                     unsigned short host_port)
 {
+   ConfigLoad();
    *session= (GGPOSession *)new SpectatorBackend(cb,
                                                  game,
                                                  local_port,
@@ -0,0 +1,58 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#ifndef _RECEIVE_THREAD_H
+#define _RECEIVE_THREAD_H
+
+#include <atomic>
+#include "types.h"
+
+#if !defined(_WINDOWS)
+#  include <pthread.h>
+#endif
+
+/*
+ * A thread which runs a job about once a millisecond until it's stopped,
+ * with the lock held.  GGPOSteam uses it to read and dispatch packets as
+ * they arrive.  Anything the job touches must only be used by other
+ * threads with the lock held too.  The lock can be taken whether or not
+ * the thread is running, and more than once by the same thread.
+ */
+class ReceiveThread {
+public:
+   typedef void (*Job)(void *context);
+
+public:
+   ReceiveThread();
+   ~ReceiveThread();
+
+   bool Start(Job job, void *context);
+   void Stop();
+   bool IsRunning() { return _running; }
+
+   void Lock();
+   void Unlock();
+
+protected:
+   Job               _job;
+   void              *_context;
+   bool              _running;
+   std::atomic<bool> _quit;
+#if defined(_WINDOWS)
+   static DWORD WINAPI ThreadProc(void *arg);
+
+   HANDLE            _thread;
+   CRITICAL_SECTION  _lock;
+#else
+   static void *ThreadProc(void *arg);
+
+   pthread_t         _thread;
+   pthread_mutex_t   _lock;
+#endif
+};
+
+#endif
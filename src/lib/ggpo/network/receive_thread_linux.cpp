@@ -0,0 +1,80 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#include "receive_thread.h"
+
+ReceiveThread::ReceiveThread() :
+   _job(NULL),
+   _context(NULL),
+   _running(false),
+   _quit(false)
+{
+   pthread_mutexattr_t attr;
+
+   pthread_mutexattr_init(&attr);
+   pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+   pthread_mutex_init(&_lock, &attr);
+   pthread_mutexattr_destroy(&attr);
+}
+
+ReceiveThread::~ReceiveThread()
+{
+   Stop();
+   pthread_mutex_destroy(&_lock);
+}
+
+bool
+ReceiveThread::Start(Job job, void *context)
+{
+   if (_running) {
+      return true;
+   }
+   _job = job;
+   _context = context;
+   _quit = false;
+   _running = pthread_create(&_thread, NULL, ThreadProc, this) == 0;
+   return _running;
+}
+
+/*
+ * Must not be called with the lock held, or the thread can't finish.
+ */
+void
+ReceiveThread::Stop()
+{
+   if (_running) {
+      _quit = true;
+      pthread_join(_thread, NULL);
+      _running = false;
+   }
+}
+
+void
+ReceiveThread::Lock()
+{
+   pthread_mutex_lock(&_lock);
+}
+
+void
+ReceiveThread::Unlock()
+{
+   pthread_mutex_unlock(&_lock);
+}
+
+void *
+ReceiveThread::ThreadProc(void *arg)
+{
+   ReceiveThread *thread = (ReceiveThread *)arg;
+
+   while (!thread->_quit) {
+      thread->Lock();
+      thread->_job(thread->_context);
+      thread->Unlock();
+      usleep(1000);
+   }
+   return NULL;
+}
@@ -0,0 +1,79 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#include "receive_thread.h"
+
+ReceiveThread::ReceiveThread() :
+   _job(NULL),
+   _context(NULL),
+   _running(false),
+   _quit(false),
+   _thread(NULL)
+{
+   InitializeCriticalSection(&_lock);
+}
+
+ReceiveThread::~ReceiveThread()
+{
+   Stop();
+   DeleteCriticalSection(&_lock);
+}
+
+bool
+ReceiveThread::Start(Job job, void *context)
+{
+   if (_running) {
+      return true;
+   }
+   _job = job;
+   _context = context;
+   _quit = false;
+   _thread = CreateThread(NULL, 0, ThreadProc, this, 0, NULL);
+   _running = _thread != NULL;
+   return _running;
+}
+
+/*
+ * Must not be called with the lock held, or the thread can't finish.
+ */
+void
+ReceiveThread::Stop()
+{
+   if (_running) {
+      _quit = true;
+      WaitForSingleObject(_thread, INFINITE);
+      CloseHandle(_thread);
+      _thread = NULL;
+      _running = false;
+   }
+}
+
+void
+ReceiveThread::Lock()
+{
+   EnterCriticalSection(&_lock);
+}
+
+void
+ReceiveThread::Unlock()
+{
+   LeaveCriticalSection(&_lock);
+}
+
+DWORD WINAPI
+ReceiveThread::ThreadProc(void *arg)
+{
+   ReceiveThread *thread = (ReceiveThread *)arg;
+
+   while (!thread->_quit) {
+      thread->Lock();
+      thread->_job(thread->_context);
+      thread->Unlock();
+      Sleep(1);
+   }
+   return 0;
+}
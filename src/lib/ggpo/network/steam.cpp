@@ -9,15 +9,36 @@
 
 #include "types.h"
 #include "steam.h"
+#include "config.h"
+
+static const int BATCH_HEADER_SIZE = (int)offsetof(SteamMsg, u);
 
 GGPOSteam::GGPOSteam() :
-   _callbacks(NULL)
+   _callbacks(NULL),
+   _batching(false),
+   _num_batches(0)
 {
     _local_steam_id.Clear();
+
+    /*
+     * Every input message carries all the input the peer hasn't acked,
+     * and keep alives and quality reports are sent again on a timer, so
+     * having Steam retransmit them only adds latency behind a lost packet.
+     * The handshake and acks are rare enough to leave reliable.
+     */
+    for (int i = 0; i < ARRAY_SIZE(_send_types); i++) {
+        _send_types[i] = k_EP2PSendReliable;
+    }
+    _send_types[SteamMsg::Input] = k_EP2PSendUnreliableNoDelay;
+    _send_types[SteamMsg::CompactInput] = k_EP2PSendUnreliableNoDelay;
+    _send_types[SteamMsg::QualityReport] = k_EP2PSendUnreliableNoDelay;
+    _send_types[SteamMsg::QualityReply] = k_EP2PSendUnreliableNoDelay;
+    _send_types[SteamMsg::KeepAlive] = k_EP2PSendUnreliableNoDelay;
 }
 
 GGPOSteam::~GGPOSteam(void)
 {
+    StopReceiveThread();
     _local_steam_id.Clear();
 }
 
@@ -26,6 +47,12 @@ GGPOSteam::Init(Poll *poll, Callbacks *callbacks)
 {
    _callbacks = callbacks;
 
+    if (ggpo_config.network_reliable) {
+        for (int i = 0; i < ARRAY_SIZE(_send_types); i++) {
+            SetSendType(i, k_EP2PSendReliable);
+        }
+    }
+
     SteamAPI_Init();
     SteamNetworking()->AllowP2PPacketRelay(true);
    _local_steam_id = SteamUser()->GetSteamID();
@@ -40,8 +67,133 @@ GGPOSteam::SendTo(char *buffer, int len, EP2PSend flags, CSteamID &dst)
     SteamNetworking()->SendP2PPacket(dst, buffer, len, flags);
 }
 
+/*
+ * Sends msg the way SetSendType said to send messages of its type.  If
+ * batch is set and we're between BeginBatch and EndBatch, it waits to go
+ * out with the rest of the batch instead.
+ */
+void
+GGPOSteam::SendMsg(SteamMsg *msg, CSteamID &dst, bool batch)
+{
+    EP2PSend flags = k_EP2PSendReliable;
+    if (msg->hdr.type < ARRAY_SIZE(_send_types)) {
+        flags = _send_types[msg->hdr.type];
+    }
+
+    int len = msg->PacketSize();
+    int needed = (int)sizeof(ggpo::uint16) + len;
+    if (!_batching || !batch || BATCH_HEADER_SIZE + needed > STEAM_BATCH_MAX_SIZE) {
+        SendTo((char *)msg, len, flags, dst);
+        return;
+    }
+
+    Batch *b = NULL;
+    for (int i = 0; i < _num_batches; i++) {
+        if (_batches[i].dst == dst && _batches[i].flags == flags) {
+            b = _batches + i;
+            break;
+        }
+    }
+    if (!b) {
+        if (_num_batches == ARRAY_SIZE(_batches)) {
+            SendTo((char *)msg, len, flags, dst);
+            return;
+        }
+        b = _batches + _num_batches++;
+        b->dst = dst;
+        b->flags = flags;
+        b->count = 0;
+    }
+    if (b->count && b->len + needed > STEAM_BATCH_MAX_SIZE) {
+        FlushBatch(*b);
+    }
+    if (b->count == 0) {
+        SteamMsg *hdr = (SteamMsg *)b->buffer;
+        hdr->hdr.magic = 0;
+        hdr->hdr.sequence_number = 0;
+        hdr->hdr.type = SteamMsg::Batch;
+        b->len = BATCH_HEADER_SIZE;
+    }
+
+    ggpo::uint16 msg_len = (ggpo::uint16)len;
+    memcpy(b->buffer + b->len, &msg_len, sizeof(msg_len));
+    memcpy(b->buffer + b->len + sizeof(msg_len), msg, len);
+    b->len += needed;
+    b->count++;
+}
+
+void
+GGPOSteam::BeginBatch()
+{
+    _batching = true;
+}
+
+void
+GGPOSteam::EndBatch()
+{
+    for (int i = 0; i < _num_batches; i++) {
+        FlushBatch(_batches[i]);
+    }
+    _num_batches = 0;
+    _batching = false;
+}
+
+/*
+ * A batch of one goes out as a plain message, so it costs no more than
+ * it would have unbatched.
+ */
+void
+GGPOSteam::FlushBatch(Batch &batch)
+{
+    if (batch.count == 1) {
+        int offset = BATCH_HEADER_SIZE + sizeof(ggpo::uint16);
+        SendTo((char *)batch.buffer + offset, batch.len - offset, batch.flags, batch.dst);
+    } else if (batch.count > 1) {
+        SendTo((char *)batch.buffer, batch.len, batch.flags, batch.dst);
+    }
+    batch.count = 0;
+}
+
+void
+GGPOSteam::SetSendType(int type, EP2PSend flags)
+{
+    ASSERT(type >= 0 && type < ARRAY_SIZE(_send_types));
+    _send_types[type] = flags;
+}
+
+/*
+ * Moves reading and dispatching packets off the polling thread, so they're
+ * decoded as soon as they arrive rather than when the game next polls.
+ */
+bool
+GGPOSteam::StartReceiveThread()
+{
+    return _receiver.Start(ReceiveJob, this);
+}
+
+void
+GGPOSteam::StopReceiveThread()
+{
+    _receiver.Stop();
+}
+
+void
+GGPOSteam::ReceiveJob(void *context)
+{
+    ((GGPOSteam *)context)->ReceivePackets();
+}
+
 bool
 GGPOSteam::OnLoopPoll(void *cookie)
+{
+    if (!_receiver.IsRunning()) {
+        ReceivePackets();
+    }
+    return true;
+}
+
+void
+GGPOSteam::ReceivePackets()
 {
     ggpo::uint8 recv_buf[MAX_STEAM_PACKET_SIZE];
     uint32 msgSize;
@@ -51,14 +203,14 @@ GGPOSteam::OnLoopPoll(void *cookie)
     {
         if (msgSize > MAX_STEAM_PACKET_SIZE)
         {
-            Log("Dropping oversized packet\n");
+            LogWarning("Dropping oversized packet\n");
             SteamNetworking()->ReadP2PPacket(recv_buf, MAX_STEAM_PACKET_SIZE, &msgSize, &steamIDRemote);
             continue;
         }
 
         if (!SteamNetworking()->ReadP2PPacket(recv_buf, msgSize, &msgSize, &steamIDRemote))
         {
-            Log("Failed to read packet\n");
+            LogWarning("Failed to read packet\n");
             continue;
         }
 
@@ -67,25 +219,47 @@ GGPOSteam::OnLoopPoll(void *cookie)
 			continue;
 		}
 
-        _callbacks->OnMsg(steamIDRemote, (SteamMsg *)recv_buf, msgSize);
+        SteamMsg *msg = (SteamMsg *)recv_buf;
+        if (msgSize >= BATCH_HEADER_SIZE && msg->hdr.type == SteamMsg::Batch) {
+            DispatchBatch(steamIDRemote, recv_buf, msgSize);
+        } else {
+            _callbacks->OnMsg(steamIDRemote, msg, msgSize);
+        }
     }
+}
 
-    return true;
+/*
+ * Hands each message in a batch to the callbacks as if it had arrived on
+ * its own.
+ */
+void
+GGPOSteam::DispatchBatch(CSteamID &from, ggpo::uint8 *buffer, int len)
+{
+    int offset = BATCH_HEADER_SIZE;
+
+    while (offset + (int)sizeof(ggpo::uint16) <= len) {
+        ggpo::uint16 msg_len;
+        memcpy(&msg_len, buffer + offset, sizeof(msg_len));
+        offset += sizeof(msg_len);
+        if (msg_len > len - offset) {
+            LogWarning("Dropping the rest of a truncated batch\n");
+            return;
+        }
+        SteamMsg *msg = (SteamMsg *)(buffer + offset);
+        if (msg_len >= BATCH_HEADER_SIZE && msg->hdr.type != SteamMsg::Batch) {
+            _callbacks->OnMsg(from, msg, msg_len);
+        }
+        offset += msg_len;
+    }
 }
 
 
 void
-GGPOSteam::Log(const char *fmt, ...)
+GGPOSteam::LogWrite(const char *fmt, ...)
 {
-   char buf[1024];
-   size_t offset;
    va_list args;
 
-   strcpy_s(buf, "udp | ");
-   offset = strlen(buf);
    va_start(args, fmt);
-   vsnprintf(buf + offset, ARRAY_SIZE(buf) - offset - 1, fmt, args);
-   buf[ARRAY_SIZE(buf)-1] = '\0';
-   ::Log(buf);
+   Logv("udp | ", 0, fmt, args);
    va_end(args);
 }
@@ -14,11 +14,18 @@
 #include "steam_msg.h"
 #include "ggponet.h"
 #include "ring_buffer.h"
+#include "receive_thread.h"
 
 #define MAX_STEAM_ENDPOINTS     16
 
 static const int MAX_STEAM_PACKET_SIZE = 4096;
 
+/*
+ * The most Steam will send unreliably in one packet.  Batches are kept
+ * under this whatever their send type.
+ */
+#define STEAM_BATCH_MAX_SIZE    1200
+
 class GGPOSteam : public IPollSink
 {
 public:
@@ -40,6 +47,41 @@ protected:
 	Callbacks* _callbacks;
 	Poll* _poll;
 
+	/*
+	 * How each SteamMsg type goes out, indexed by hdr.type.
+	 */
+	EP2PSend _send_types[STEAM_MSG_NUM_TYPES];
+
+	/*
+	 * Between BeginBatch and EndBatch, messages for peers which can take
+	 * them are held here, one datagram per destination and send type.
+	 * A batch datagram is a SteamMsg header of type Batch followed by
+	 * { uint16 length, message } for each message in it.
+	 */
+	struct Batch {
+	   CSteamID       dst;
+	   EP2PSend       flags;
+	   int            count;
+	   int            len;
+	   ggpo::uint8    buffer[STEAM_BATCH_MAX_SIZE];
+	};
+	bool  _batching;
+	int   _num_batches;
+	Batch _batches[MAX_STEAM_ENDPOINTS];
+
+	void FlushBatch(Batch &batch);
+	void DispatchBatch(CSteamID &from, ggpo::uint8 *buffer, int len);
+
+	/*
+	 * Once started, packets are read and dispatched on this thread
+	 * instead of from OnLoopPoll.  Callbacks and everything they touch
+	 * must then only be used with Lock held.
+	 */
+	ReceiveThread _receiver;
+
+	void ReceivePackets();
+	static void ReceiveJob(void *context);
+
 public:
    GGPOSteam();
    ~GGPOSteam(void);
@@ -49,11 +91,33 @@ public:
    void Init(Poll *p, Callbacks *callbacks);
    
    void SendTo(char *buffer, int len, EP2PSend flags, CSteamID &dst);
+   void SendMsg(SteamMsg *msg, CSteamID &dst, bool batch = false);
+   void SetSendType(int type, EP2PSend flags);
+
+   void BeginBatch();
+   void EndBatch();
+
+   bool StartReceiveThread();
+   void StopReceiveThread();
+   void Lock() { _receiver.Lock(); }
+   void Unlock() { _receiver.Unlock(); }
+
+   /*
+    * Holds the lock for as long as it's in scope.
+    */
+   class AutoLock {
+   public:
+      AutoLock(GGPOSteam &steam) : _steam(steam) { _steam.Lock(); }
+      ~AutoLock() { _steam.Unlock(); }
+
+   protected:
+      GGPOSteam &_steam;
+   };
 
    virtual bool OnLoopPoll(void *cookie);
 
 protected:
-	void Log(const char* fmt, ...);
+	void LogWrite(const char* fmt, ...);
 };
 
 #endif
@@ -10,8 +10,20 @@
 #ifndef _STEAM_MSG_H
 #define _STEAM_MSG_H
 
+#include <stddef.h>
+#include "varint.h"
+
 #define MAX_COMPRESSED_BITS       4096
+
+/*
+ * The most input bits a message can carry.  u.input.bits is declared
+ * with MAX_COMPRESSED_BITS bytes, but messages only get
+ * STEAM_MSG_MAX_SIZE bytes of storage, so just the first
+ * MAX_COMPRESSED_BITS / 8 of them can be written.
+ */
+#define STEAM_MSG_MAX_INPUT_BITS  MAX_COMPRESSED_BITS
 #define STEAM_MSG_MAX_PLAYERS          4
+#define STEAM_MSG_NUM_TYPES            10
 
 #pragma pack(push, 1)
 
@@ -26,6 +38,32 @@ struct SteamMsg
       QualityReply  = 5,
       KeepAlive     = 6,
       InputAck      = 7,
+      Batch         = 8,             /* several messages in one datagram.  See GGPOSteam. */
+      CompactInput  = 9,             /* Input with a smaller header.  See u.compact_input. */
+   };
+
+   /*
+    * How u.input.bits is encoded.  Each side lists the codecs it can
+    * decode in its sync messages, and sends with ByteMaskCodec only if
+    * the other listed it.
+    */
+   enum InputCodec {
+      BitCodec      = 0,             /* BitVector: a bit, an on/off bit and a nibblet per changed button */
+      ByteMaskCodec = 1,             /* bytemask.h */
+   };
+
+   /*
+    * Optional parts of the protocol, listed in sync messages the same way.
+    */
+   enum Feature {
+      BatchFeature  = 0,             /* can receive Batch datagrams */
+      CompactInputFeature = 1,       /* can receive CompactInput messages */
+   };
+
+   enum CompactInputFlags {
+      CompactDisconnectRequested = 1,
+      CompactConnectStatus       = 2,   /* some peer_connect_status last_frames follow.  See u.compact_input. */
+      CompactDisconnected        = 4,   /* the peer_connect_status disconnected flags follow */
    };
 
    struct connect_status {
@@ -43,10 +81,16 @@ struct SteamMsg
          ggpo::uint32      random_request;  /* please reply back with this random data */
          ggpo::uint16      remote_magic;
          ggpo::uint8       remote_endpoint;
+         ggpo::uint8       input_codecs;    /* 1 << InputCodec for each we can decode.  Missing from old peers. */
+         ggpo::uint8       features;        /* 1 << Feature for each we support.  Missing from old peers. */
+         ggpo::uint8       input_size;      /* of the inputs we'll send, so CompactInput can leave it out */
       } sync_request;
       
       struct {
          ggpo::uint32      random_reply;    /* OK, here's your random data back */
+         ggpo::uint8       input_codecs;    /* as in sync_request */
+         ggpo::uint8       features;
+         ggpo::uint8       input_size;
       } sync_reply;
       
       struct {
@@ -71,6 +115,29 @@ struct SteamMsg
          ggpo::uint8             bits[MAX_COMPRESSED_BITS]; /* must be last */
       } input;
 
+      /*
+       * The same as input, but with the input size left to the sync
+       * messages, only the parts of the connect status which changed
+       * lately, and the frame numbers as varints:
+       *
+       *    ack_frame + 1
+       *    num_bits
+       *    start_frame - ack_frame, zigzagged (only if num_bits)
+       *    a byte with bit i set for each player disconnected (only with
+       *       CompactDisconnected)
+       *    a byte with bit i set for each player whose last_frame follows,
+       *       then those last_frames less start_frame, or ack_frame if
+       *       there's no input, zigzagged (only with CompactConnectStatus)
+       *    bits
+       *
+       * Anything left out of the connect status is taken to be what the
+       * receiver already has.
+       */
+      struct {
+         ggpo::uint8       flags;           /* CompactInputFlags */
+         ggpo::uint8       data[(3 + STEAM_MSG_MAX_PLAYERS) * VARINT_MAX_BYTES + 2 + MAX_COMPRESSED_BITS / 8];
+      } compact_input;
+
       struct {
          int               ack_frame:31;
       } input_ack;
@@ -96,14 +163,47 @@ public:
          size = (int)((char *)&u.input.bits - (char *)&u.input);
          size += (u.input.num_bits + 7) / 8;
          return size;
+      case CompactInput:
+         return CompactInputSize();
       }
       ASSERT(false);
       return 0;
    }
 
+   int CompactInputSize() {
+      int offset = 0;
+      ggpo::uint32 value, num_bits = 0;
+      int len = sizeof(u.compact_input.data);
+
+      Varint_Read(u.compact_input.data, len, &offset, &value);
+      Varint_Read(u.compact_input.data, len, &offset, &num_bits);
+      if (num_bits) {
+         Varint_Read(u.compact_input.data, len, &offset, &value);
+      }
+      if (u.compact_input.flags & CompactDisconnected) {
+         offset++;
+      }
+      if ((u.compact_input.flags & CompactConnectStatus) && offset < len) {
+         ggpo::uint8 players = u.compact_input.data[offset++];
+         for (int i = 0; i < STEAM_MSG_MAX_PLAYERS; i++) {
+            if (players & (1 << i)) {
+               Varint_Read(u.compact_input.data, len, &offset, &value);
+            }
+         }
+      }
+      return (int)sizeof(u.compact_input.flags) + offset + (num_bits + 7) / 8;
+   }
+
    SteamMsg(MsgType t) { hdr.type = (ggpo::uint8)t; }
 };
 
 #pragma pack(pop)
 
+/*
+ * The most bytes a SteamMsg can take on the wire: a compact input message
+ * with MAX_COMPRESSED_BITS bits, whose varints can make it a few bytes
+ * longer than the plain one at worst.
+ */
+#define STEAM_MSG_MAX_SIZE        (offsetof(SteamMsg, u.compact_input.data) + sizeof(((SteamMsg *)0)->u.compact_input.data))
+
 #endif   
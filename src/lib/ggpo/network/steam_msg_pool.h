@@ -0,0 +1,85 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#ifndef _STEAM_MSG_POOL_H
+#define _STEAM_MSG_POOL_H
+
+#include "types.h"
+#include "steam_msg.h"
+
+/*
+ * Buffers for the messages a SteamProtocol has queued to send, so sending
+ * doesn't allocate.  Each is only as big as the largest message we can
+ * actually send (STEAM_MSG_MAX_SIZE), not the whole SteamMsg, whose
+ * input bits are sized in bits rather than bytes.  If every buffer is in
+ * use, Alloc falls back to the heap and counts it in heap_allocs.
+ */
+template<int N> class SteamMsgPool
+{
+public:
+   SteamMsgPool<N>() :
+      _slab(NULL),
+      _num_free(0),
+      _heap_allocs(0) {
+   }
+
+   ~SteamMsgPool<N>() {
+      delete [] _slab;
+   }
+
+   /*
+    * Call before the first alloc.
+    */
+   void init() {
+      if (_slab) {
+         return;
+      }
+      _slab = new ggpo::uint64[N * SlotWords];
+      for (int i = 0; i < N; i++) {
+         _free[i] = N - 1 - i;
+      }
+      _num_free = N;
+   }
+
+   SteamMsg *alloc(SteamMsg::MsgType type) {
+      SteamMsg *msg;
+      if (_num_free) {
+         msg = (SteamMsg *)(_slab + _free[--_num_free] * SlotWords);
+      } else {
+         msg = (SteamMsg *)new ggpo::uint64[SlotWords];
+         _heap_allocs++;
+      }
+      msg->hdr.type = (ggpo::uint8)type;
+      return msg;
+   }
+
+   void release(SteamMsg *msg) {
+      ggpo::uint64 *p = (ggpo::uint64 *)msg;
+      if (_slab && p >= _slab && p < _slab + N * SlotWords) {
+         ASSERT(_num_free < N);
+         _free[_num_free++] = (int)((p - _slab) / SlotWords);
+      } else {
+         delete [] p;
+      }
+   }
+
+   int heap_allocs() {
+      return _heap_allocs;
+   }
+
+protected:
+   enum {
+      SlotWords = (STEAM_MSG_MAX_SIZE + sizeof(ggpo::uint64) - 1) / sizeof(ggpo::uint64)
+   };
+
+   ggpo::uint64   *_slab;
+   int            _free[N];
+   int            _num_free;
+   int            _heap_allocs;
+};
+
+#endif
@@ -6,6 +6,9 @@
 #include "steam_proto.h"
 #include "types.h"
 #include "bitvector.h"
+#include "bytemask.h"
+#include "config.h"
+#include "varint.h"
 
 static const int STEAM_HEADER_SIZE = 28; // TODO: Find out what the actual size is, metrics will be wrong until then
 static const int NUM_SYNC_PACKETS = 5;
@@ -18,6 +21,18 @@ static const int NETWORK_STATS_INTERVAL  = 1000;
 static const int STEAM_SHUTDOWN_TIMER = 5000;
 static const int MAX_SEQ_DISTANCE = (1 << 15);
 
+/*
+ * The byte mask codec has to fit a frame of the largest input in a
+ * message whatever changed, or some inputs could never be sent.
+ */
+#if BYTEMASK_MAX_FRAME_SIZE(GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS) > STEAM_MSG_MAX_INPUT_BITS / 8
+#  error GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS is too large to fit in a SteamMsg
+#endif
+static const ggpo::uint8 INPUT_CODECS = (1 << SteamMsg::BitCodec) | (1 << SteamMsg::ByteMaskCodec);
+static const ggpo::uint8 FEATURES = (1 << SteamMsg::BatchFeature) | (1 << SteamMsg::CompactInputFeature);
+static const int CONNECT_STATUS_REFRESH_INTERVAL = 100;
+static const int CONNECT_STATUS_RESEND_TIME      = 500;
+
 SteamProtocol::SteamProtocol() :
     _local_frame_advantage(0),
     _remote_frame_advantage(0),
@@ -35,7 +50,14 @@ SteamProtocol::SteamProtocol() :
     _disconnect_event_sent(false),
     _connected(false),
     _next_send_seq(0),
-    _next_recv_seq(0)
+    _next_recv_seq(0),
+    _input_codec(SteamMsg::BitCodec),
+    _peer_batches(false),
+    _compact_input(false),
+    _input_size(0),
+    _peer_input_size(0),
+    _disconnected_changed_time(0),
+    _status_sent_time(0)
 {
     _last_sent_input.init(-1, NULL, 1);
     _last_received_input.init(-1, NULL, 1);
@@ -43,14 +65,17 @@ SteamProtocol::SteamProtocol() :
 
     memset(&_state, 0, sizeof _state);
     memset(_peer_connect_status, 0, sizeof(_peer_connect_status));
+    memset(_status_sent, 0, sizeof(_status_sent));
+    memset(_status_changed_time, 0, sizeof(_status_changed_time));
     for (int i = 0; i < ARRAY_SIZE(_peer_connect_status); i++) {
         _peer_connect_status[i].last_frame = -1;
+        _status_sent[i].last_frame = -1;
     }
     //memset(&_peer_addr, 0, sizeof _peer_addr);
     _oo_packet.msg = NULL;
 
-    _send_latency = Platform::GetConfigInt("ggpo.network.delay");
-    _oop_percent = Platform::GetConfigInt("ggpo.oop.percent");
+    _send_latency = ggpo_config.network_delay;
+    _oop_percent = ggpo_config.oop_percent;
 }
 
 SteamProtocol::~SteamProtocol()
@@ -63,11 +88,14 @@ void SteamProtocol::Init(
     const CSteamID& remoteSteamID,
     Poll &poll,
     int queue,
+    int input_size,
     SteamMsg::connect_status *status
 ) {
     _steam = steam;
+    _input_size = input_size;
     _peer_steam_id = remoteSteamID;
     _local_connect_status = status;
+    _msg_pool.init();
     SteamNetworking()->AcceptP2PSessionWithUser(_peer_steam_id);
 
     do {
@@ -104,35 +132,25 @@ SteamProtocol::SendInput(GameInput &input)
 void
 SteamProtocol::SendPendingOutput()
 {
-    SteamMsg *msg = new SteamMsg(SteamMsg::Input);
-    int i, j, offset = 0;
-    ggpo::uint8 *bits;
-    GameInput last;
+    SteamMsg *msg = _msg_pool.alloc(SteamMsg::Input);
+    int offset = 0;
 
     if (_pending_output.size()) {
-        last = _last_acked_input;
-        bits = msg->u.input.bits;
-
         msg->u.input.start_frame = _pending_output.front().frame;
         msg->u.input.input_size = (ggpo::uint8)_pending_output.front().size;
 
-        ASSERT(last.frame == -1 || last.frame + 1 == msg->u.input.start_frame);
-        for (j = 0; j < _pending_output.size(); j++) {
-            GameInput &current = _pending_output.item(j);
-            if (memcmp(current.bits, last.bits, current.size) != 0) {
-                ASSERT((GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS * 8) < (1 << BITVECTOR_NIBBLE_SIZE));
-                for (i = 0; i < current.size * 8; i++) {
-                    ASSERT(i < (1 << BITVECTOR_NIBBLE_SIZE));
-                    if (current.value(i) != last.value(i)) {
-                        BitVector_SetBit(msg->u.input.bits, &offset);
-                        (current.value(i) ? BitVector_SetBit : BitVector_ClearBit)(bits, &offset);
-                        BitVector_WriteNibblet(bits, i, &offset);
-                    }
-                }
-            }
-            BitVector_ClearBit(msg->u.input.bits, &offset);
-            last = _last_sent_input = current;
+        ASSERT(_last_acked_input.frame == -1 || _last_acked_input.frame + 1 == msg->u.input.start_frame);
+        int frames;
+        if (_input_codec == SteamMsg::ByteMaskCodec) {
+            offset = EncodeByteMaskInputs(msg, STEAM_MSG_MAX_INPUT_BITS, &frames);
+        } else {
+            offset = EncodeBitInputs(msg, STEAM_MSG_MAX_INPUT_BITS, &frames);
         }
+        ASSERT(frames > 0);      /* SetPeerInputCodecs only picks a codec a frame fits */
+        if (frames < _pending_output.size()) {
+            Log("Sending %d of %d pending frames.  The rest won't fit.\n", frames, _pending_output.size());
+        }
+        _last_sent_input = _pending_output.item(frames - 1);
     } else {
         msg->u.input.start_frame = 0;
         msg->u.input.input_size = 0;
@@ -147,15 +165,231 @@ SteamProtocol::SendPendingOutput()
         memset(msg->u.input.peer_connect_status, 0, sizeof(SteamMsg::connect_status) * STEAM_MSG_MAX_PLAYERS);
     }
 
-    ASSERT(offset < MAX_COMPRESSED_BITS);
+    ASSERT(offset <= STEAM_MSG_MAX_INPUT_BITS);
 
+    if (_compact_input) {
+        msg = PackInput(msg);
+    }
     SendMsg(msg);
 }
 
+/*
+ * Turns an Input message into a CompactInput one, releasing the original.
+ */
+SteamMsg *
+SteamProtocol::PackInput(SteamMsg *msg)
+{
+    SteamMsg *packed = _msg_pool.alloc(SteamMsg::CompactInput);
+    ggpo::uint8 *data = packed->u.compact_input.data;
+    int ack_frame = msg->u.input.ack_frame;
+    int num_bits = msg->u.input.num_bits;
+    int base_frame = num_bits ? (int)msg->u.input.start_frame : ack_frame;
+    int offset = 0;
+
+    ASSERT(!num_bits || msg->u.input.input_size == _input_size);
+
+    packed->u.compact_input.flags = 0;
+    if (msg->u.input.disconnect_requested) {
+        packed->u.compact_input.flags |= SteamMsg::CompactDisconnectRequested;
+    }
+    Varint_Write(data, &offset, (ggpo::uint32)(ack_frame + 1));
+    Varint_Write(data, &offset, (ggpo::uint32)num_bits);
+    if (num_bits) {
+        Varint_Write(data, &offset, Varint_ZigZag((int)msg->u.input.start_frame - ack_frame));
+    }
+
+    /*
+     * The peer starts out with every player connected at frame -1 and
+     * only ever moves on from there, so players which are still like
+     * that never need sending.
+     */
+    SteamMsg::connect_status *status = msg->u.input.peer_connect_status;
+    unsigned int now = Platform::GetCurrentTimeMS();
+    bool refresh = !_status_sent_time || now >= _status_sent_time + CONNECT_STATUS_REFRESH_INTERVAL;
+    ggpo::uint8 disconnected = 0, players = 0;
+    int i;
+
+    for (i = 0; i < STEAM_MSG_MAX_PLAYERS; i++) {
+        if (status[i].disconnected != _status_sent[i].disconnected) {
+            _disconnected_changed_time = now;
+        }
+        if (status[i].last_frame != _status_sent[i].last_frame) {
+            _status_changed_time[i] = now;
+        }
+        _status_sent[i] = status[i];
+        if (status[i].disconnected) {
+            disconnected |= 1 << i;
+        }
+        if (status[i].last_frame != -1 &&
+            (refresh || now < _status_changed_time[i] + CONNECT_STATUS_RESEND_TIME)) {
+            players |= 1 << i;
+        }
+    }
+    if (refresh) {
+        _status_sent_time = now;
+    }
+    if (disconnected && (refresh || now < _disconnected_changed_time + CONNECT_STATUS_RESEND_TIME)) {
+        packed->u.compact_input.flags |= SteamMsg::CompactDisconnected;
+        data[offset++] = disconnected;
+    }
+    if (players) {
+        packed->u.compact_input.flags |= SteamMsg::CompactConnectStatus;
+        data[offset++] = players;
+        for (i = 0; i < STEAM_MSG_MAX_PLAYERS; i++) {
+            if (players & (1 << i)) {
+                Varint_Write(data, &offset, Varint_ZigZag(status[i].last_frame - base_frame));
+            }
+        }
+    }
+
+    memcpy(data + offset, msg->u.input.bits, (num_bits + 7) / 8);
+
+    _msg_pool.release(msg);
+    return packed;
+}
+
+/*
+ * Turns a CompactInput message back into an Input one, filling in what
+ * was left out.  Any part of the connect status it doesn't carry comes
+ * from the one we already have from the peer, which OnInput leaves as it
+ * is.  Returns NULL if the message is malformed.
+ */
+SteamMsg *
+SteamProtocol::UnpackInput(SteamMsg *msg, int len, int *unpacked_len)
+{
+    const ggpo::uint8 *data = msg->u.compact_input.data;
+    int data_len = len - (int)offsetof(SteamMsg, u.compact_input.data);
+    int offset = 0;
+    ggpo::uint32 ack, num_bits, start = 0;
+
+    if (data_len < 0 ||
+        !Varint_Read(data, data_len, &offset, &ack) ||
+        !Varint_Read(data, data_len, &offset, &num_bits) ||
+        (num_bits && !Varint_Read(data, data_len, &offset, &start)) ||
+        num_bits > STEAM_MSG_MAX_INPUT_BITS) {
+        return NULL;
+    }
+
+    SteamMsg *unpacked = _msg_pool.alloc(SteamMsg::Input);
+    unpacked->hdr = msg->hdr;
+    unpacked->hdr.type = SteamMsg::Input;
+    unpacked->u.input.disconnect_requested = (msg->u.compact_input.flags & SteamMsg::CompactDisconnectRequested) != 0;
+    unpacked->u.input.ack_frame = (int)ack - 1;
+    unpacked->u.input.num_bits = (ggpo::uint16)num_bits;
+    unpacked->u.input.start_frame = num_bits ? (int)ack - 1 + Varint_UnZigZag(start) : 0;
+    unpacked->u.input.input_size = num_bits ? (ggpo::uint8)_peer_input_size : 0;
+
+    SteamMsg::connect_status *status = unpacked->u.input.peer_connect_status;
+    int base_frame = num_bits ? (int)unpacked->u.input.start_frame : unpacked->u.input.ack_frame;
+    int i;
+
+    memcpy(status, _peer_connect_status, sizeof(unpacked->u.input.peer_connect_status));
+    if (msg->u.compact_input.flags & SteamMsg::CompactDisconnected) {
+        if (offset >= data_len) {
+            _msg_pool.release(unpacked);
+            return NULL;
+        }
+        ggpo::uint8 disconnected = data[offset++];
+        for (i = 0; i < STEAM_MSG_MAX_PLAYERS; i++) {
+            if (disconnected & (1 << i)) {
+                status[i].disconnected = 1;
+            }
+        }
+    }
+    if (msg->u.compact_input.flags & SteamMsg::CompactConnectStatus) {
+        if (offset >= data_len) {
+            _msg_pool.release(unpacked);
+            return NULL;
+        }
+        ggpo::uint8 players = data[offset++];
+        for (i = 0; i < STEAM_MSG_MAX_PLAYERS; i++) {
+            ggpo::uint32 delta;
+            if (!(players & (1 << i))) {
+                continue;
+            }
+            if (!Varint_Read(data, data_len, &offset, &delta)) {
+                _msg_pool.release(unpacked);
+                return NULL;
+            }
+            status[i].last_frame = base_frame + Varint_UnZigZag(delta);
+        }
+    }
+
+    int bytes = MIN((int)(num_bits + 7) / 8, data_len - offset);
+    memcpy(unpacked->u.input.bits, data + offset, bytes);
+    *unpacked_len = (int)offsetof(SteamMsg, u.input.bits) + bytes;
+    return unpacked;
+}
+
+/*
+ * Writes each pending frame's changes from the one before it as BitVector
+ * bits, stopping at the first frame which would take the message past
+ * max_bits.  The rest go out in a later message.  Returns how many bits
+ * that took, and the number of frames in *frames.
+ */
+int
+SteamProtocol::EncodeBitInputs(SteamMsg *msg, int max_bits, int *frames)
+{
+    ggpo::uint8 *bits = msg->u.input.bits;
+    GameInput last = _last_acked_input;
+    int i, j, offset = 0;
+
+    for (j = 0; j < _pending_output.size(); j++) {
+        GameInput &current = _pending_output.item(j);
+        int changed = 0;
+        if (memcmp(current.bits, last.bits, current.size) != 0) {
+            for (i = 0; i < current.size * 8; i++) {
+                changed += current.value(i) != last.value(i);
+            }
+        }
+        if (offset + changed * (2 + BITVECTOR_NIBBLE_SIZE) + 1 > max_bits) {
+            break;
+        }
+        if (changed) {
+            ASSERT((GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS * 8) < (1 << BITVECTOR_NIBBLE_SIZE));
+            for (i = 0; i < current.size * 8; i++) {
+                ASSERT(i < (1 << BITVECTOR_NIBBLE_SIZE));
+                if (current.value(i) != last.value(i)) {
+                    BitVector_SetBit(bits, &offset);
+                    (current.value(i) ? BitVector_SetBit : BitVector_ClearBit)(bits, &offset);
+                    BitVector_WriteNibblet(bits, i, &offset);
+                }
+            }
+        }
+        BitVector_ClearBit(bits, &offset);
+        last = current;
+    }
+    *frames = j;
+    return offset;
+}
+
+/*
+ * The same, with the byte mask codec.  Returns bits too, so num_bits
+ * means the same thing for both.
+ */
+int
+SteamProtocol::EncodeByteMaskInputs(SteamMsg *msg, int max_bits, int *frames)
+{
+    ByteMaskWriter writer;
+    const GameInput *last = &_last_acked_input;
+    int j;
+
+    ByteMask_Begin(&writer, msg->u.input.bits, max_bits / 8, _pending_output.front().size);
+    for (j = 0; j < _pending_output.size(); j++) {
+        GameInput &current = _pending_output.item(j);
+        if (!ByteMask_WriteFrame(&writer, last->bits, current.bits)) {
+            break;
+        }
+        last = &current;
+    }
+    *frames = j;
+    return ByteMask_End(&writer) * 8;
+}
+
 void
 SteamProtocol::SendInputAck()
 {
-    SteamMsg *msg = new SteamMsg(SteamMsg::InputAck);
+    SteamMsg *msg = _msg_pool.alloc(SteamMsg::InputAck);
     msg->u.input_ack.ack_frame = _last_received_input.frame;
     SendMsg(msg);
 }
@@ -163,12 +397,7 @@ SteamProtocol::SendInputAck()
 bool
 SteamProtocol::GetEvent(SteamProtocol::Event &e)
 {
-    if (_event_queue.size() == 0) {
-        return false;
-    }
-    e = _event_queue.front();
-    _event_queue.pop();
-    return true;
+    return _event_queue.pop(e);
 }
 
 
@@ -201,7 +430,7 @@ SteamProtocol::OnLoopPoll(void *cookie)
         }
 
         if (!_state.running.last_quality_report_time || _state.running.last_quality_report_time + QUALITY_REPORT_INTERVAL < now) {
-            SteamMsg *msg = new SteamMsg(SteamMsg::QualityReport);
+            SteamMsg *msg = _msg_pool.alloc(SteamMsg::QualityReport);
             msg->u.quality_report.ping = Platform::GetCurrentTimeMS();
             msg->u.quality_report.frame_advantage = (ggpo::uint8)_local_frame_advantage;
             SendMsg(msg);
@@ -215,12 +444,12 @@ SteamProtocol::OnLoopPoll(void *cookie)
 
         if (_last_send_time && _last_send_time + KEEP_ALIVE_INTERVAL < now) {
             Log("Sending keep alive packet\n");
-            SendMsg(new SteamMsg(SteamMsg::KeepAlive));
+            SendMsg(_msg_pool.alloc(SteamMsg::KeepAlive));
         }
 
         if (_disconnect_timeout && _disconnect_notify_start && 
             !_disconnect_notify_sent && (_last_recv_time + _disconnect_notify_start < now)) {
-            Log("Endpoint has stopped receiving packets for %d ms.  Sending notification.\n", _disconnect_notify_start);
+            LogInfo("Endpoint has stopped receiving packets for %d ms.  Sending notification.\n", _disconnect_notify_start);
             Event e(Event::NetworkInterrupted);
             e.u.network_interrupted.disconnect_timeout = _disconnect_timeout - _disconnect_notify_start;
             QueueEvent(e);
@@ -229,7 +458,7 @@ SteamProtocol::OnLoopPoll(void *cookie)
 
         if (_disconnect_timeout && (_last_recv_time + _disconnect_timeout < now)) {
             if (!_disconnect_event_sent) {
-                Log("Endpoint has stopped receiving packets for %d ms.  Disconnecting.\n", _disconnect_timeout);
+                LogInfo("Endpoint has stopped receiving packets for %d ms.  Disconnecting.\n", _disconnect_timeout);
                 QueueEvent(Event(Event::Disconnected));
                 _disconnect_event_sent = true;
             }
@@ -259,8 +488,11 @@ void
 SteamProtocol::SendSyncRequest()
 {
     _state.sync.random = rand() & 0xFFFF;
-    SteamMsg *msg = new SteamMsg(SteamMsg::SyncRequest);
+    SteamMsg *msg = _msg_pool.alloc(SteamMsg::SyncRequest);
     msg->u.sync_request.random_request = _state.sync.random;
+    msg->u.sync_request.input_codecs = INPUT_CODECS;
+    msg->u.sync_request.features = FEATURES;
+    msg->u.sync_request.input_size = (ggpo::uint8)_input_size;
     SendMsg(msg);
 }
 
@@ -300,6 +532,8 @@ SteamProtocol::OnMsg(SteamMsg *msg, int len)
         &SteamProtocol::OnQualityReply,          /* QualityReply */
         &SteamProtocol::OnKeepAlive,              /* KeepAlive */
         &SteamProtocol::OnInputAck,                /* InputAck */
+        &SteamProtocol::OnInvalid,                 /* Batch, unpacked by GGPOSteam */
+        &SteamProtocol::OnCompactInput,            /* CompactInput */
     };
 
     // filter out messages that don't match what we expect
@@ -311,16 +545,25 @@ SteamProtocol::OnMsg(SteamMsg *msg, int len)
             return;
         }
 
-        // filter out out-of-order packets
+        /*
+         * Most messages go out unreliable, so they can arrive late, twice
+         * or not at all.  A late input message has nothing a newer one
+         * didn't, and a late quality report would wind the frame advantage
+         * back, so those are dropped.  The rest are still worth handling,
+         * but mustn't move _next_recv_seq backwards.
+         */
         ggpo::uint16 skipped = (ggpo::uint16)((int)seq - (int)_next_recv_seq);
-        // Log("checking sequence number -> next - seq : %d - %d = %d\n", seq, _next_recv_seq, skipped);
         if (skipped > MAX_SEQ_DISTANCE) {
-            Log("dropping out of order packet (seq: %d, last seq:%d)\n", seq, _next_recv_seq);
-            return;
+            if (msg->hdr.type == SteamMsg::Input || msg->hdr.type == SteamMsg::CompactInput ||
+                msg->hdr.type == SteamMsg::QualityReport) {
+                Log("dropping out of order packet (seq: %d, next seq:%d)\n", seq, _next_recv_seq);
+                return;
+            }
+        } else {
+            _next_recv_seq = seq + 1;
         }
     }
 
-    _next_recv_seq = seq;
     LogMsg("recv", msg);
     if (msg->hdr.type >= ARRAY_SIZE(table)) {
         OnInvalid(msg, len);
@@ -361,11 +604,19 @@ SteamProtocol::UpdateNetworkStats(void)
        steam_overhead);
 }
 
-void
+/*
+ * Returns false if the game hasn't kept up with the events, and this one
+ * was dropped.
+ */
+bool
 SteamProtocol::QueueEvent(const SteamProtocol::Event &evt)
 {
     LogEvent("Queuing event", evt);
-    _event_queue.push(evt);
+    if (!_event_queue.push(evt)) {
+        LogWarning("Event queue full.  Dropping event.\n");
+        return false;
+    }
+    return true;
 }
 
 void
@@ -386,18 +637,12 @@ SteamProtocol::GetPeerConnectStatus(int id, int *frame)
 }
 
 void
-SteamProtocol::Log(const char *fmt, ...)
+SteamProtocol::LogWrite(const char *fmt, ...)
 {
-    char buf[1024];
-    size_t offset;
     va_list args;
 
-    sprintf_s(buf, ARRAY_SIZE(buf), "steam_proto%d | ", _queue);
-    offset = strlen(buf);
     va_start(args, fmt);
-    vsnprintf(buf + offset, ARRAY_SIZE(buf) - offset - 1, fmt, args);
-    buf[ARRAY_SIZE(buf)-1] = '\0';
-    ::Log(buf);
+    Logv("steam_proto%d | ", _queue, fmt, args);
     va_end(args);
 }
 
@@ -406,12 +651,12 @@ SteamProtocol::LogMsg(const char *prefix, SteamMsg *msg)
 {
     switch (msg->hdr.type) {
     case SteamMsg::SyncRequest:
-        Log("%s sync-request (%d).\n", prefix,
-             msg->u.sync_request.random_request);
+        Log("%s sync-request (%d, codecs %x).\n", prefix,
+             msg->u.sync_request.random_request, msg->u.sync_request.input_codecs);
         break;
     case SteamMsg::SyncReply:
-        Log("%s sync-reply (%d).\n", prefix,
-             msg->u.sync_reply.random_reply);
+        Log("%s sync-reply (%d, codecs %x).\n", prefix,
+             msg->u.sync_reply.random_reply, msg->u.sync_reply.input_codecs);
         break;
     case SteamMsg::QualityReport:
         Log("%s quality report.\n", prefix);
@@ -428,6 +673,9 @@ SteamProtocol::LogMsg(const char *prefix, SteamMsg *msg)
     case SteamMsg::InputAck:
         Log("%s input ack.\n", prefix);
         break;
+    case SteamMsg::CompactInput:
+        Log("%s compact-input (%d bytes).\n", prefix, msg->PayloadSize());
+        break;
     default:
         ASSERT(FALSE && "Unknown SteamMsg type.");
     }
@@ -458,12 +706,69 @@ SteamProtocol::OnSyncRequest(SteamMsg *msg, int len)
               msg->hdr.magic, _remote_magic_number);
         return false;
     }
-    SteamMsg *reply = new SteamMsg(SteamMsg::SyncReply);
+    if (!SetPeerInputCodecs(msg, len, (int)offsetof(SteamMsg, u.sync_request.input_codecs))) {
+        return false;
+    }
+    SetPeerFeatures(msg, len, (int)offsetof(SteamMsg, u.sync_request.features), (int)offsetof(SteamMsg, u.sync_request.input_size));
+
+    SteamMsg *reply = _msg_pool.alloc(SteamMsg::SyncReply);
     reply->u.sync_reply.random_reply = msg->u.sync_request.random_request;
+    reply->u.sync_reply.input_codecs = INPUT_CODECS;
+    reply->u.sync_reply.features = FEATURES;
+    reply->u.sync_reply.input_size = (ggpo::uint8)_input_size;
     SendMsg(reply);
     return true;
 }
 
+/*
+ * Picks the input codec from the list in a sync message.  Peers which
+ * predate the list send shorter messages, and only know BitCodec.  Both
+ * sides see each other's list before either sends input, and each picks
+ * the best codec the pair has in common, so the two always agree.
+ *
+ * A frame of our input where every bit changed may not fit in a message
+ * with BitCodec.  A peer which only knows that one can't be synced with,
+ * so returns false to ignore its message.
+ */
+bool
+SteamProtocol::SetPeerInputCodecs(SteamMsg *msg, int len, int offset)
+{
+    ggpo::uint8 codecs = len > offset ? ((ggpo::uint8 *)msg)[offset] : 0;
+
+    if (_current_state != Syncing) {
+        return true;
+    }
+    if ((codecs & INPUT_CODECS) & (1 << SteamMsg::ByteMaskCodec)) {
+        _input_codec = SteamMsg::ByteMaskCodec;
+    } else if (BITVECTOR_MAX_FRAME_BITS(_input_size) <= STEAM_MSG_MAX_INPUT_BITS) {
+        _input_codec = SteamMsg::BitCodec;
+    } else {
+        Log("Peer only knows the bit codec, which can't fit our %d byte inputs in a message.\n", _input_size);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Notes which optional features the peer listed in a sync message, and
+ * the size of the inputs it will send.  Only features both sides support
+ * get used.
+ */
+void
+SteamProtocol::SetPeerFeatures(SteamMsg *msg, int len, int features_offset, int input_size_offset)
+{
+    ggpo::uint8 features = len > features_offset ? ((ggpo::uint8 *)msg)[features_offset] : 0;
+    ggpo::uint8 input_size = len > input_size_offset ? ((ggpo::uint8 *)msg)[input_size_offset] : 0;
+
+    if (_current_state != Syncing) {
+        return;
+    }
+    features &= FEATURES;
+    _peer_batches = (features & (1 << SteamMsg::BatchFeature)) != 0;
+    _compact_input = (features & (1 << SteamMsg::CompactInputFeature)) != 0 && _input_size > 0;
+    _peer_input_size = input_size;
+}
+
 bool
 SteamProtocol::OnSyncReply(SteamMsg *msg, int len)
 {
@@ -478,6 +783,11 @@ SteamProtocol::OnSyncReply(SteamMsg *msg, int len)
         return false;
     }
 
+    if (!SetPeerInputCodecs(msg, len, (int)offsetof(SteamMsg, u.sync_reply.input_codecs))) {
+        return false;
+    }
+    SetPeerFeatures(msg, len, (int)offsetof(SteamMsg, u.sync_reply.features), (int)offsetof(SteamMsg, u.sync_reply.input_size));
+
     if (!_connected) {
         QueueEvent(Event(Event::Connected));
         _connected = true;
@@ -509,7 +819,7 @@ SteamProtocol::OnInput(SteamMsg *msg, int len)
     bool disconnect_requested = msg->u.input.disconnect_requested;
     if (disconnect_requested) {
         if (_current_state != Disconnected && !_disconnect_event_sent) {
-            Log("Disconnecting endpoint on remote request.\n");
+            LogInfo("Disconnecting endpoint on remote request.\n");
             QueueEvent(Event(Event::Disconnected));
             _disconnect_event_sent = true;
         }
@@ -531,69 +841,67 @@ SteamProtocol::OnInput(SteamMsg *msg, int len)
      */
     int last_received_frame_number = _last_received_input.frame;
     if (msg->u.input.num_bits) {
-        int offset = 0;
-        ggpo::uint8 *bits = (ggpo::uint8 *)msg->u.input.bits;
-        int numBits = msg->u.input.num_bits;
         int currentFrame = msg->u.input.start_frame;
+        GameInput next;
 
         _last_received_input.size = msg->u.input.input_size;
         if (_last_received_input.frame < 0) {
             _last_received_input.frame = msg->u.input.start_frame - 1;
         }
-        while (offset < numBits) {
-            /*
-             * Keep walking through the frames (parsing bits) until we reach
-             * the inputs for the frame right after the one we're on.
-             */
-            ASSERT(currentFrame <= (_last_received_input.frame + 1));
-            bool useInputs = currentFrame == _last_received_input.frame + 1;
-
-            while (BitVector_ReadBit(bits, &offset)) {
-                int on = BitVector_ReadBit(bits, &offset);
-                int button = BitVector_ReadNibblet(bits, &offset);
-                if (useInputs) {
-                    if (on) {
-                        _last_received_input.set(button);
-                    } else {
-                        _last_received_input.clear(button);
+        if (_input_codec == SteamMsg::ByteMaskCodec) {
+            ByteMaskReader reader;
+            int bytes = MIN(msg->u.input.num_bits / 8, len - (int)offsetof(SteamMsg, u.input.bits));
+
+            if (ByteMask_BeginRead(&reader, msg->u.input.bits, bytes, _last_received_input.size)) {
+                for (;;) {
+                    /*
+                     * Frames we already have are parsed and thrown away,
+                     * the same as below.
+                     */
+                    ASSERT(currentFrame <= (_last_received_input.frame + 1));
+                    bool useInputs = currentFrame == _last_received_input.frame + 1;
+                    if (useInputs) {
+                        next = _last_received_input;
+                    }
+                    if (!ByteMask_ReadFrame(&reader, useInputs ? next.bits : NULL) ||
+                        !OnInputFrame(currentFrame++, useInputs, next)) {
+                        break;
                     }
                 }
             }
-            ASSERT(offset <= numBits);
-
-            /*
-             * Now if we want to use these inputs, go ahead and send them to
-             * the emulator.
-             */
-            if (useInputs) {
-                /*
-                 * Move forward 1 frame in the stream.
-                 */
-                char desc[1024];
-                ASSERT(currentFrame == _last_received_input.frame + 1);
-                _last_received_input.frame = currentFrame;
+        } else {
+            int offset = 0;
+            ggpo::uint8 *bits = (ggpo::uint8 *)msg->u.input.bits;
+            int numBits = msg->u.input.num_bits;
 
+            while (offset < numBits) {
                 /*
-                 * Send the event to the emualtor
+                 * Keep walking through the frames (parsing bits) until we reach
+                 * the inputs for the frame right after the one we're on.
                  */
-                SteamProtocol::Event evt(SteamProtocol::Event::Input);
-                evt.u.input.input = _last_received_input;
-
-                _last_received_input.desc(desc, ARRAY_SIZE(desc));
-
-                _state.running.last_input_packet_recv_time = Platform::GetCurrentTimeMS();
+                ASSERT(currentFrame <= (_last_received_input.frame + 1));
+                bool useInputs = currentFrame == _last_received_input.frame + 1;
+                if (useInputs) {
+                    next = _last_received_input;
+                }
 
-                Log("Sending frame %d to emu queue %d (%s).\n", _last_received_input.frame, _queue, desc);
-                QueueEvent(evt);
+                while (BitVector_ReadBit(bits, &offset)) {
+                    int on = BitVector_ReadBit(bits, &offset);
+                    int button = BitVector_ReadNibblet(bits, &offset);
+                    if (useInputs) {
+                        if (on) {
+                            next.set(button);
+                        } else {
+                            next.clear(button);
+                        }
+                    }
+                }
+                ASSERT(offset <= numBits);
 
-            } else {
-                Log("Skipping past frame:(%d) current is %d.\n", currentFrame, _last_received_input.frame);
+                if (!OnInputFrame(currentFrame++, useInputs, next)) {
+                    break;
+                }
             }
-
-            /*
-             * Move forward 1 frame in the input stream.
-             */
-            currentFrame++;
         }
     }
     ASSERT(_last_received_input.frame >= last_received_frame_number);
@@ -610,6 +918,63 @@ SteamProtocol::OnInput(SteamMsg *msg, int len)
 }
 
 
+/*
+ * Called for each frame in an input message with _last_received_input
+ * plus the frame's changes in input.  Passes new frames on to the
+ * emulator.  If the emulator's queue is full, the frame isn't taken, so
+ * it isn't acked and the peer sends it again, and this returns false.
+ */
+bool
+SteamProtocol::OnInputFrame(int frame, bool use_inputs, GameInput &input)
+{
+    if (!use_inputs) {
+        Log("Skipping past frame:(%d) current is %d.\n", frame, _last_received_input.frame);
+        return true;
+    }
+
+    /*
+     * Send the event to the emualtor, then move forward 1 frame in the
+     * stream.
+     */
+    ASSERT(frame == _last_received_input.frame + 1);
+    input.frame = frame;
+
+    SteamProtocol::Event evt(SteamProtocol::Event::Input);
+    evt.u.input.input = input;
+    if (!QueueEvent(evt)) {
+        return false;
+    }
+    _last_received_input = input;
+
+    _state.running.last_input_packet_recv_time = Platform::GetCurrentTimeMS();
+
+    if (LogEnabled(LOG_LEVEL_VERBOSE)) {
+        char desc[1024];
+        _last_received_input.desc(desc, ARRAY_SIZE(desc));
+        Log("Sending frame %d to emu queue %d (%s).\n", _last_received_input.frame, _queue, desc);
+    }
+    return true;
+}
+
+bool
+SteamProtocol::OnCompactInput(SteamMsg *msg, int len)
+{
+    int unpacked_len;
+
+    if (!_peer_input_size) {
+        Log("Ignoring compact input from a peer which never told us its input size.\n");
+        return false;
+    }
+    SteamMsg *unpacked = UnpackInput(msg, len, &unpacked_len);
+    if (!unpacked) {
+        Log("Dropping malformed compact input.\n");
+        return false;
+    }
+    bool handled = OnInput(unpacked, unpacked_len);
+    _msg_pool.release(unpacked);
+    return handled;
+}
+
 bool
 SteamProtocol::OnInputAck(SteamMsg *msg, int len)
 {
@@ -628,7 +993,7 @@ bool
 SteamProtocol::OnQualityReport(SteamMsg *msg, int len)
 {
     // send a reply so the other side can compute the round trip transmit time.
-    SteamMsg *reply = new SteamMsg(SteamMsg::QualityReply);
+    SteamMsg *reply = _msg_pool.alloc(SteamMsg::QualityReply);
     reply->u.quality_reply.pong = msg->u.quality_report.ping;
     SendMsg(reply);
 
@@ -655,6 +1020,7 @@ SteamProtocol::GetNetworkStats(struct GGPONetworkStats *s)
     s->network.ping = _round_trip_time;
     s->network.send_queue_len = _pending_output.size();
     s->network.kbps_sent = _kbps_sent;
+    s->network.send_heap_allocs = _msg_pool.heap_allocs();
     s->timesync.remote_frames_behind = _remote_frame_advantage;
     s->timesync.local_frames_behind = _local_frame_advantage;
 }
@@ -717,22 +1083,22 @@ SteamProtocol::PumpSendQueue()
             Log("creating rogue oop (seq: %d  delay: %d)\n", entry.msg->hdr.sequence_number, delay);
             _oo_packet.send_time = Platform::GetCurrentTimeMS() + delay;
             _oo_packet.msg = entry.msg;
-            //_oo_packet.dest_addr = entry.dest_addr; // TODO: Implement this
+            _oo_packet.steam_id = entry.steam_id;
         } else {
             ASSERT(entry.steam_id.IsValid());
 
-            _steam->SendTo((char *)entry.msg, entry.msg->PacketSize(), k_EP2PSendReliable, entry.steam_id);
+            _steam->SendMsg(entry.msg, entry.steam_id, _peer_batches);
 
-            delete entry.msg;
+            _msg_pool.release(entry.msg);
         }
         _send_queue.pop();
     }
     if (_oo_packet.msg && _oo_packet.send_time < Platform::GetCurrentTimeMS()) {
         Log("sending rogue oop!");
 
-        _steam->SendTo((char *)_oo_packet.msg, _oo_packet.msg->PacketSize(), k_EP2PSendReliable, _oo_packet.steam_id);
+        _steam->SendMsg(_oo_packet.msg, _oo_packet.steam_id, _peer_batches);
 
-        delete _oo_packet.msg;
+        _msg_pool.release(_oo_packet.msg);
         _oo_packet.msg = NULL;
     }
 }
@@ -741,7 +1107,7 @@ void
 SteamProtocol::ClearSendQueue()
 {
     while (!_send_queue.empty()) {
-        delete _send_queue.front().msg;
+        _msg_pool.release(_send_queue.front().msg);
         _send_queue.pop();
     }
 }
@@ -17,6 +17,11 @@
 #include "timesync.h"
 #include "ggponet.h"
 #include "ring_buffer.h"
+#include "spsc_ring.h"
+#include "steam_msg_pool.h"
+
+#define STEAM_SEND_QUEUE_LENGTH   64
+#define STEAM_EVENT_QUEUE_LENGTH  128
 
 class SteamProtocol : public IPollSink
 {
@@ -65,7 +70,7 @@ public:
    SteamProtocol();
    virtual ~SteamProtocol();
 
-   void Init(GGPOSteam *steam, const CSteamID& remoteSteamID, Poll &p, int queue, SteamMsg::connect_status *status);
+   void Init(GGPOSteam *steam, const CSteamID& remoteSteamID, Poll &p, int queue, int input_size, SteamMsg::connect_status *status);
 
    void Synchronize();
    bool GetPeerConnectStatus(int id, int *frame);
@@ -105,9 +110,9 @@ protected:
 
    bool CreateSocket(int retries);
    void UpdateNetworkStats(void);
-   void QueueEvent(const SteamProtocol::Event &evt);
+   bool QueueEvent(const SteamProtocol::Event &evt);
    void ClearSendQueue(void);
-   void Log(const char *fmt, ...);
+   void LogWrite(const char *fmt, ...);
    void LogMsg(const char *prefix, SteamMsg *msg);
    void LogEvent(const char *prefix, const SteamProtocol::Event &evt);
    void SendSyncRequest();
@@ -115,6 +120,13 @@ protected:
    void PumpSendQueue();
    void DispatchMsg(ggpo::uint8 *buffer, int len);
    void SendPendingOutput();
+   int EncodeBitInputs(SteamMsg *msg, int max_bits, int *frames);
+   int EncodeByteMaskInputs(SteamMsg *msg, int max_bits, int *frames);
+   bool SetPeerInputCodecs(SteamMsg *msg, int len, int offset);
+   void SetPeerFeatures(SteamMsg *msg, int len, int features_offset, int input_size_offset);
+   SteamMsg *PackInput(SteamMsg *msg);
+   SteamMsg *UnpackInput(SteamMsg *msg, int len, int *unpacked_len);
+   bool OnInputFrame(int frame, bool use_inputs, GameInput &input);
    bool OnInvalid(SteamMsg *msg, int len);
    bool OnSyncRequest(SteamMsg *msg, int len);
    bool OnSyncReply(SteamMsg *msg, int len);
@@ -123,6 +135,7 @@ protected:
    bool OnQualityReport(SteamMsg *msg, int len);
    bool OnQualityReply(SteamMsg *msg, int len);
    bool OnKeepAlive(SteamMsg *msg, int len);
+   bool OnCompactInput(SteamMsg *msg, int len);
 
 protected:
    /*
@@ -141,7 +154,14 @@ protected:
       CSteamID    steam_id;
       SteamMsg*     msg;
    }              _oo_packet;
-   RingBuffer<QueueEntry, 64> _send_queue;
+   RingBuffer<QueueEntry, STEAM_SEND_QUEUE_LENGTH> _send_queue;
+
+   /*
+    * Room for a full send queue (which holds one less than its length),
+    * the out of order packet and the message being built, plus the one
+    * it's packed into or unpacked from for CompactInput.
+    */
+   SteamMsgPool<STEAM_SEND_QUEUE_LENGTH + 2> _msg_pool;
 
    /*
     * Stats
@@ -195,15 +215,39 @@ protected:
    ggpo::uint16                     _next_send_seq;
    ggpo::uint16                     _next_recv_seq;
 
+   /*
+    * Picked from what the peer said it can decode while syncing.
+    */
+   SteamMsg::InputCodec             _input_codec;
+   bool                             _peer_batches;
+
+   /*
+    * CompactInput.  The input sizes come from the sync messages.  Each
+    * part of the connect status goes out whenever it changes, including a
+    * last_frame moving on, since the peer waits on the lowest one.  It
+    * keeps going out for a while after a change in case some are lost,
+    * and all of it goes out on a timer otherwise.
+    */
+   bool                             _compact_input;
+   int                              _input_size;
+   int                              _peer_input_size;
+   SteamMsg::connect_status         _status_sent[STEAM_MSG_MAX_PLAYERS];
+   unsigned int                     _status_changed_time[STEAM_MSG_MAX_PLAYERS];
+   unsigned int                     _disconnected_changed_time;
+   unsigned int                     _status_sent_time;
+
    /*
     * Rift synchronization.
     */
    TimeSync                   _timesync;
 
    /*
-    * Event queue
+    * Event queue.  Events are queued with the GGPOSteam lock held, from
+    * the receive thread or the polling one, and taken off by the game
+    * without it.  Big enough for every input the peer can get ahead of
+    * us by, which come through here too.
     */
-   RingBuffer<SteamProtocol::Event, 64>  _event_queue;
+   SpscRing<SteamProtocol::Event, STEAM_EVENT_QUEUE_LENGTH>  _event_queue;
 };
 
 #endif
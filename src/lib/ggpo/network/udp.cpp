@@ -71,7 +71,7 @@ Udp::SendTo(char *buffer, int len, int flags, struct sockaddr *dst, int destlen)
    int res = sendto(_socket, buffer, len, flags, dst, destlen);
    if (res == SOCKET_ERROR) {
       DWORD err = WSAGetLastError();
-      Log("unknown error in sendto (erro: %d  wsaerr: %d).\n", res, err);
+      LogError("unknown error in sendto (erro: %d  wsaerr: %d).\n", res, err);
       ASSERT(FALSE && "Unknown error in sendto");
    }
    char dst_ip[1024];
@@ -94,7 +94,7 @@ Udp::OnLoopPoll(void *cookie)
       if (len == -1) {
          int error = WSAGetLastError();
          if (error != WSAEWOULDBLOCK) {
-            Log("recvfrom WSAGetLastError returned %d (%x).\n", error, error);
+            LogError("recvfrom WSAGetLastError returned %d (%x).\n", error, error);
          }
          break;
       } else if (len > 0) {
@@ -109,17 +109,11 @@ Udp::OnLoopPoll(void *cookie)
 
 
 void
-Udp::Log(const char *fmt, ...)
+Udp::LogWrite(const char *fmt, ...)
 {
-   char buf[1024];
-   size_t offset;
    va_list args;
 
-   strcpy_s(buf, "udp | ");
-   offset = strlen(buf);
    va_start(args, fmt);
-   vsnprintf(buf + offset, ARRAY_SIZE(buf) - offset - 1, fmt, args);
-   buf[ARRAY_SIZE(buf)-1] = '\0';
-   ::Log(buf);
+   Logv("udp | ", 0, fmt, args);
    va_end(args);
 }
@@ -33,7 +33,7 @@ public:
 
 
 protected:
-   void Log(const char *fmt, ...);
+   void LogWrite(const char *fmt, ...);
 
 public:
    Udp();
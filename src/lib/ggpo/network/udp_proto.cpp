@@ -8,6 +8,7 @@
 #include "types.h"
 #include "udp_proto.h"
 #include "bitvector.h"
+#include "config.h"
 
 static const int UDP_HEADER_SIZE = 28;     /* Size of IP + UDP headers */
 static const int NUM_SYNC_PACKETS = 5;
@@ -52,8 +53,8 @@ UdpProtocol::UdpProtocol() :
    memset(&_peer_addr, 0, sizeof _peer_addr);
    _oo_packet.msg = NULL;
 
-   _send_latency = Platform::GetConfigInt("ggpo.network.delay");
-   _oop_percent = Platform::GetConfigInt("ggpo.oop.percent");
+   _send_latency = ggpo_config.network_delay;
+   _oop_percent = ggpo_config.oop_percent;
 }
 
 UdpProtocol::~UdpProtocol()
@@ -226,7 +227,7 @@ UdpProtocol::OnLoopPoll(void *cookie)
 
       if (_disconnect_timeout && _disconnect_notify_start && 
          !_disconnect_notify_sent && (_last_recv_time + _disconnect_notify_start < now)) {
-         Log("Endpoint has stopped receiving packets for %d ms.  Sending notification.\n", _disconnect_notify_start);
+         LogInfo("Endpoint has stopped receiving packets for %d ms.  Sending notification.\n", _disconnect_notify_start);
          Event e(Event::NetworkInterrupted);
          e.u.network_interrupted.disconnect_timeout = _disconnect_timeout - _disconnect_notify_start;
          QueueEvent(e);
@@ -235,7 +236,7 @@ UdpProtocol::OnLoopPoll(void *cookie)
 
       if (_disconnect_timeout && (_last_recv_time + _disconnect_timeout < now)) {
          if (!_disconnect_event_sent) {
-            Log("Endpoint has stopped receiving packets for %d ms.  Disconnecting.\n", _disconnect_timeout);
+            LogInfo("Endpoint has stopped receiving packets for %d ms.  Disconnecting.\n", _disconnect_timeout);
             QueueEvent(Event(Event::Disconnected));
             _disconnect_event_sent = true;
          }
@@ -399,18 +400,12 @@ UdpProtocol::GetPeerConnectStatus(int id, int *frame)
 }
 
 void
-UdpProtocol::Log(const char *fmt, ...)
+UdpProtocol::LogWrite(const char *fmt, ...)
 {
-   char buf[1024];
-   size_t offset;
    va_list args;
 
-   sprintf_s(buf, ARRAY_SIZE(buf), "udpproto%d | ", _queue);
-   offset = strlen(buf);
    va_start(args, fmt);
-   vsnprintf(buf + offset, ARRAY_SIZE(buf) - offset - 1, fmt, args);
-   buf[ARRAY_SIZE(buf)-1] = '\0';
-   ::Log(buf);
+   Logv("udpproto%d | ", _queue, fmt, args);
    va_end(args);
 }
 
@@ -522,7 +517,7 @@ UdpProtocol::OnInput(UdpMsg *msg, int len)
    bool disconnect_requested = msg->u.input.disconnect_requested;
    if (disconnect_requested) {
       if (_current_state != Disconnected && !_disconnect_event_sent) {
-         Log("Disconnecting endpoint on remote request.\n");
+         LogInfo("Disconnecting endpoint on remote request.\n");
          QueueEvent(Event(Event::Disconnected));
          _disconnect_event_sent = true;
       }
@@ -582,7 +577,6 @@ UdpProtocol::OnInput(UdpMsg *msg, int len)
             /*
              * Move forward 1 frame in the stream.
              */
-            char desc[1024];
             ASSERT(currentFrame == _last_received_input.frame + 1);
             _last_received_input.frame = currentFrame;
 
@@ -592,11 +586,13 @@ UdpProtocol::OnInput(UdpMsg *msg, int len)
             UdpProtocol::Event evt(UdpProtocol::Event::Input);
             evt.u.input.input = _last_received_input;
 
-            _last_received_input.desc(desc, ARRAY_SIZE(desc));
-
             _state.running.last_input_packet_recv_time = Platform::GetCurrentTimeMS();
 
-            Log("Sending frame %d to emu queue %d (%s).\n", _last_received_input.frame, _queue, desc);
+            if (LogEnabled(LOG_LEVEL_VERBOSE)) {
+               char desc[1024];
+               _last_received_input.desc(desc, ARRAY_SIZE(desc));
+               Log("Sending frame %d to emu queue %d (%s).\n", _last_received_input.frame, _queue, desc);
+            }
             QueueEvent(evt);
 
          } else {
@@ -668,6 +664,7 @@ UdpProtocol::GetNetworkStats(struct GGPONetworkStats *s)
    s->network.ping = _round_trip_time;
    s->network.send_queue_len = _pending_output.size();
    s->network.kbps_sent = _kbps_sent;
+   s->network.send_heap_allocs = 0;
    s->timesync.remote_frames_behind = _remote_frame_advantage;
    s->timesync.local_frames_behind = _local_frame_advantage;
 }
@@ -0,0 +1,64 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#ifndef _PAGE_SNAPSHOT_H
+#define _PAGE_SNAPSHOT_H
+
+#include "types.h"
+
+/*
+ * Saves a contiguous region of game state page by page, using the
+ * operating system's dirty page tracking to find the pages written since
+ * the last save.  A shadow copy of the region holds the state as of the
+ * last save, and each saved frame keeps the old contents of the pages
+ * which changed between it and the frame saved after it, much like the
+ * deltas used by GGPO_SNAPSHOT_DELTA.
+ *
+ * Only implemented on Linux, where Init fails if the region cannot be
+ * tracked.
+ */
+class PageSnapshots {
+public:
+   PageSnapshots();
+   ~PageSnapshots();
+
+   bool Init(void *base, int size, int num_slots);
+   int Save(int slot, int prev);
+   int Revert();
+   int Rewind(int slot);
+   void ClearDirty();
+
+   ggpo::byte *GetBase() { return _base; }
+   int GetSize() { return _size; }
+
+protected:
+   struct Journal {
+      int         *pages;
+      ggpo::byte  *data;
+      int         count;
+      int         capacity;
+   };
+
+   int FindDirtyPages();
+   int PageBytes(int page, ggpo::byte **start);
+   void Record(Journal &journal, int page, ggpo::byte *old);
+
+protected:
+   ggpo::byte     *_base;
+   int            _size;
+   int            _page_size;
+   size_t         _first_page;      /* page number of the page containing _base */
+   int            _num_pages;
+   ggpo::byte     *_shadow;         /* the region as of the last save */
+   Journal        *_journals;
+   int            _num_slots;
+   int            *_dirty;
+   int            _pagemap;
+   bool           _soft_dirty;
+};
+
+#endif
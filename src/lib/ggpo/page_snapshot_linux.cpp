@@ -0,0 +1,260 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include "page_snapshot.h"
+
+/*
+ * Dirty pages are found with the kernel's soft-dirty bits: writing "4" to
+ * /proc/self/clear_refs clears them for the whole process, and bit 55 of
+ * a page's entry in /proc/self/pagemap is set again on the first write
+ * to it.  If the kernel doesn't track soft-dirty bits every page is
+ * treated as dirty, which still only copies the pages that changed.
+ */
+#define PAGEMAP_SOFT_DIRTY    (1ULL << 55)
+
+PageSnapshots::PageSnapshots() :
+   _base(NULL),
+   _size(0),
+   _page_size(0),
+   _first_page(0),
+   _num_pages(0),
+   _shadow(NULL),
+   _journals(NULL),
+   _num_slots(0),
+   _dirty(NULL),
+   _pagemap(-1),
+   _soft_dirty(false)
+{
+}
+
+PageSnapshots::~PageSnapshots()
+{
+   for (int i = 0; i < _num_slots; i++) {
+      delete [] _journals[i].pages;
+      delete [] _journals[i].data;
+   }
+   delete [] _journals;
+   delete [] _shadow;
+   delete [] _dirty;
+   if (_pagemap >= 0) {
+      close(_pagemap);
+   }
+}
+
+bool
+PageSnapshots::Init(void *base, int size, int num_slots)
+{
+   ASSERT(!_base);
+   if (!base || size <= 0) {
+      return false;
+   }
+   _page_size = (int)sysconf(_SC_PAGESIZE);
+   if (_page_size <= 0) {
+      return false;
+   }
+
+   _base = (ggpo::byte *)base;
+   _size = size;
+   _first_page = (size_t)_base / _page_size;
+   _num_pages = (int)(((size_t)_base + size - 1) / _page_size - _first_page) + 1;
+   _num_slots = num_slots;
+
+   _shadow = new ggpo::byte[size];
+   memcpy(_shadow, _base, size);
+   _dirty = new int[_num_pages];
+   _journals = new Journal[num_slots];
+   memset(_journals, 0, sizeof(Journal) * num_slots);
+
+   /*
+    * Make sure the soft-dirty bits actually work before relying on them by
+    * writing a byte of the region back to itself and checking that its
+    * page shows up as dirty.
+    */
+   _pagemap = open("/proc/self/pagemap", O_RDONLY);
+   if (_pagemap >= 0) {
+      _soft_dirty = true;
+      ClearDirty();
+      if (_soft_dirty) {
+         volatile ggpo::byte *probe = _base;
+         *probe = *probe;
+         int count = FindDirtyPages();
+         _soft_dirty = _soft_dirty && count > 0 && _dirty[0] == 0;
+      }
+   }
+   if (!_soft_dirty) {
+      Log("Soft-dirty page tracking unavailable.  Comparing every page of the state instead.\n");
+   }
+   Log("Tracking %d bytes of state in %d pages.\n", _size, _num_pages);
+   return true;
+}
+
+/*
+ * Records the pages which changed since the last save in the journal for
+ * the frame saved at prev, so it can be rebuilt later, and brings the
+ * shadow copy up to date.  Returns the number of bytes copied.
+ */
+int
+PageSnapshots::Save(int slot, int prev)
+{
+   int bytes = 0;
+   int count = FindDirtyPages();
+
+   _journals[slot].count = 0;
+   for (int i = 0; i < count; i++) {
+      ggpo::byte *start;
+      int offset = PageBytes(_dirty[i], &start);
+      int len = PageBytes(_dirty[i], NULL);
+      if (!memcmp(start, _shadow + offset, len)) {
+         continue;
+      }
+      if (prev >= 0) {
+         Record(_journals[prev], _dirty[i], _shadow + offset);
+      }
+      memcpy(_shadow + offset, start, len);
+      bytes += len;
+   }
+   ClearDirty();
+   return bytes;
+}
+
+/*
+ * Undoes every write made to the region since the last save or load.
+ */
+int
+PageSnapshots::Revert()
+{
+   int bytes = 0;
+   int count = FindDirtyPages();
+
+   for (int i = 0; i < count; i++) {
+      ggpo::byte *start;
+      int offset = PageBytes(_dirty[i], &start);
+      int len = PageBytes(_dirty[i], NULL);
+      if (memcmp(start, _shadow + offset, len)) {
+         memcpy(start, _shadow + offset, len);
+         bytes += len;
+      }
+   }
+   return bytes;
+}
+
+/*
+ * Steps the region and the shadow copy back from the frame saved after
+ * slot to the frame saved in it.
+ */
+int
+PageSnapshots::Rewind(int slot)
+{
+   Journal &journal = _journals[slot];
+   int bytes = 0;
+
+   for (int i = 0; i < journal.count; i++) {
+      ggpo::byte *start;
+      int offset = PageBytes(journal.pages[i], &start);
+      int len = PageBytes(journal.pages[i], NULL);
+      memcpy(start, journal.data + (i * _page_size), len);
+      memcpy(_shadow + offset, start, len);
+      bytes += len;
+   }
+   journal.count = 0;
+   return bytes;
+}
+
+void
+PageSnapshots::ClearDirty()
+{
+   if (!_soft_dirty) {
+      return;
+   }
+   int fd = open("/proc/self/clear_refs", O_WRONLY);
+   if (fd < 0 || write(fd, "4", 1) != 1) {
+      LogWarning("Failed to clear soft-dirty bits.\n");
+      _soft_dirty = false;
+   }
+   if (fd >= 0) {
+      close(fd);
+   }
+}
+
+/*
+ * Fills _dirty with the indices of the pages written since the soft-dirty
+ * bits were last cleared and returns how many there are.
+ */
+int
+PageSnapshots::FindDirtyPages()
+{
+   int count = 0;
+
+   if (_soft_dirty) {
+      uint64_t entries[64];
+      for (int i = 0; i < _num_pages; i += ARRAY_SIZE(entries)) {
+         int n = MIN(_num_pages - i, (int)ARRAY_SIZE(entries));
+         off_t offset = (off_t)(_first_page + i) * sizeof(entries[0]);
+         if (pread(_pagemap, entries, n * sizeof(entries[0]), offset) != (ssize_t)(n * sizeof(entries[0]))) {
+            LogWarning("Failed to read pagemap.  Comparing every page of the state instead.\n");
+            _soft_dirty = false;
+            break;
+         }
+         for (int j = 0; j < n; j++) {
+            if (entries[j] & PAGEMAP_SOFT_DIRTY) {
+               _dirty[count++] = i + j;
+            }
+         }
+      }
+   }
+   if (!_soft_dirty) {
+      for (count = 0; count < _num_pages; count++) {
+         _dirty[count] = count;
+      }
+   }
+   return count;
+}
+
+/*
+ * Returns the offset into the region of the part of the page which
+ * overlaps it, or its length when start is NULL.  The first and last
+ * pages may hold memory which isn't part of the state, so it's important
+ * never to touch the rest of them.
+ */
+int
+PageSnapshots::PageBytes(int page, ggpo::byte **start)
+{
+   size_t lo = (size_t)(_first_page + page) * _page_size;
+   size_t hi = lo + _page_size;
+   lo = MAX(lo, (size_t)_base);
+   hi = MIN(hi, (size_t)_base + _size);
+   if (!start) {
+      return (int)(hi - lo);
+   }
+   *start = (ggpo::byte *)lo;
+   return (int)(lo - (size_t)_base);
+}
+
+void
+PageSnapshots::Record(Journal &journal, int page, ggpo::byte *old)
+{
+   if (journal.count == journal.capacity) {
+      int capacity = MAX(journal.capacity * 2, 4);
+      int *pages = new int[capacity];
+      ggpo::byte *data = new ggpo::byte[capacity * _page_size];
+      if (journal.count) {
+         memcpy(pages, journal.pages, journal.count * sizeof(int));
+         memcpy(data, journal.data, journal.count * _page_size);
+      }
+      delete [] journal.pages;
+      delete [] journal.data;
+      journal.pages = pages;
+      journal.data = data;
+      journal.capacity = capacity;
+   }
+   journal.pages[journal.count] = page;
+   memcpy(journal.data + (journal.count * _page_size), old, PageBytes(page, NULL));
+   journal.count++;
+}
@@ -0,0 +1,58 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#include "page_snapshot.h"
+
+/*
+ * Page snapshots are not supported on Windows yet.  GetWriteWatch would
+ * work, but only for memory GGPO.net allocated itself.
+ */
+
+PageSnapshots::PageSnapshots() :
+   _base(NULL),
+   _size(0),
+   _shadow(NULL),
+   _journals(NULL),
+   _dirty(NULL)
+{
+}
+
+PageSnapshots::~PageSnapshots()
+{
+}
+
+bool
+PageSnapshots::Init(void *base, int size, int num_slots)
+{
+   return false;
+}
+
+int
+PageSnapshots::Save(int slot, int prev)
+{
+   ASSERT(FALSE);
+   return 0;
+}
+
+int
+PageSnapshots::Revert()
+{
+   ASSERT(FALSE);
+   return 0;
+}
+
+int
+PageSnapshots::Rewind(int slot)
+{
+   ASSERT(FALSE);
+   return 0;
+}
+
+void
+PageSnapshots::ClearDirty()
+{
+}
@@ -5,19 +5,37 @@
  * in the LICENSE file.
  */
 
-#include "platform_linux.h"
+#include <strings.h>
+#include <time.h>
+#include "types.h"
 
-struct timespec start = { 0 }
+struct timespec start = { 0 };
 
 ggpo::uint32 Platform::GetCurrentTimeMS() {
     if (start.tv_sec == 0 && start.tv_nsec == 0) {
         clock_gettime(CLOCK_MONOTONIC, &start);
-        return 0
+        return 0;
     }
     struct timespec current;
     clock_gettime(CLOCK_MONOTONIC, &current);
 
     return ((current.tv_sec - start.tv_sec) * 1000) +
-           ((current.tv_nsec  - start.tv_nsec ) / 1000000) +
+           ((current.tv_nsec  - start.tv_nsec ) / 1000000);
 }
 
+ggpo::uint32 Platform::GetCurrentTimeUS() {
+    struct timespec current;
+    clock_gettime(CLOCK_MONOTONIC, &current);
+
+    return (ggpo::uint32)((current.tv_sec * 1000000) + (current.tv_nsec / 1000));
+}
+
+int Platform::GetConfigInt(const char* name) {
+    const char *value = getenv(name);
+    return value ? atoi(value) : 0;
+}
+
+bool Platform::GetConfigBool(const char* name) {
+    const char *value = getenv(name);
+    return value && (atoi(value) != 0 || strcasecmp(value, "true") == 0);
+}
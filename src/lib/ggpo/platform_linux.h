@@ -22,6 +22,9 @@ public:  // functions
    static ProcessID GetProcessID() { return getpid(); }
    static void AssertFailed(char *msg) { }
    static ggpo::uint32 GetCurrentTimeMS();
+   static ggpo::uint32 GetCurrentTimeUS();
+   static int GetConfigInt(const char* name);
+   static bool GetConfigBool(const char* name);
 };
 
 #endif
@@ -7,6 +7,24 @@
 
 #include "platform_windows.h"
 
+/*
+ * Microseconds from the performance counter.  Wraps after about 71
+ * minutes, so only use it to measure short intervals.
+ */
+ggpo::uint32
+Platform::GetCurrentTimeUS()
+{
+   static LARGE_INTEGER frequency = { 0 };
+   LARGE_INTEGER now;
+
+   if (frequency.QuadPart == 0) {
+      QueryPerformanceFrequency(&frequency);
+   }
+   QueryPerformanceCounter(&now);
+   return (ggpo::uint32)(((now.QuadPart / frequency.QuadPart) * 1000000) +
+                         ((now.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart));
+}
+
 int
 Platform::GetConfigInt(const char* name)
 {
@@ -22,6 +22,7 @@ public:  // functions
    static ProcessID GetProcessID() { return GetCurrentProcessId(); }
    static void AssertFailed(char *msg) { MessageBoxA(NULL, msg, "GGPO Assertion Failed", MB_OK | MB_ICONEXCLAMATION); }
    static ggpo::uint32 GetCurrentTimeMS() { return timeGetTime(); }
+   static ggpo::uint32 GetCurrentTimeUS();
    static int GetConfigInt(const char* name);
    static bool GetConfigBool(const char* name);
 };
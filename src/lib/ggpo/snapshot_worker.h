@@ -0,0 +1,60 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#ifndef _SNAPSHOT_WORKER_H
+#define _SNAPSHOT_WORKER_H
+
+#include "types.h"
+
+#if !defined(_WINDOWS)
+#  include <pthread.h>
+#endif
+
+/*
+ * A thread which runs a single job over and over, one Post at a time.
+ * Sync uses it to copy the game state into a snapshot slot while the
+ * game goes on to render the frame, and to run speculative branches.
+ * Post, Wait and IsBusy must be called from the same thread, and there's
+ * never more than one job in flight.
+ */
+class SnapshotWorker {
+public:
+   typedef void (*Job)(void *context);
+
+public:
+   SnapshotWorker();
+   ~SnapshotWorker();
+
+   bool Start(Job job, void *context);
+   void Post();
+   void Wait();
+
+   bool IsBusy();
+
+protected:
+   Job            _job;
+   void           *_context;
+   bool           _busy;
+   bool           _quit;
+#if defined(_WINDOWS)
+   static DWORD WINAPI ThreadProc(void *arg);
+
+   HANDLE         _thread;
+   HANDLE         _start;
+   HANDLE         _done;
+#else
+   static void *ThreadProc(void *arg);
+
+   bool           _started;
+   bool           _posted;
+   pthread_t      _thread;
+   pthread_mutex_t _lock;
+   pthread_cond_t _cond;
+#endif
+};
+
+#endif
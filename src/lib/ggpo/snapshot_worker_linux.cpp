@@ -0,0 +1,100 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#include "snapshot_worker.h"
+
+SnapshotWorker::SnapshotWorker() :
+   _job(NULL),
+   _context(NULL),
+   _busy(false),
+   _quit(false),
+   _started(false),
+   _posted(false)
+{
+   pthread_mutex_init(&_lock, NULL);
+   pthread_cond_init(&_cond, NULL);
+}
+
+SnapshotWorker::~SnapshotWorker()
+{
+   if (_started) {
+      Wait();
+      pthread_mutex_lock(&_lock);
+      _quit = true;
+      pthread_cond_broadcast(&_cond);
+      pthread_mutex_unlock(&_lock);
+      pthread_join(_thread, NULL);
+   }
+   pthread_cond_destroy(&_cond);
+   pthread_mutex_destroy(&_lock);
+}
+
+bool
+SnapshotWorker::Start(Job job, void *context)
+{
+   ASSERT(!_started);
+
+   _job = job;
+   _context = context;
+   _started = pthread_create(&_thread, NULL, ThreadProc, this) == 0;
+   return _started;
+}
+
+void
+SnapshotWorker::Post()
+{
+   pthread_mutex_lock(&_lock);
+   ASSERT(!_busy);
+   _busy = _posted = true;
+   pthread_cond_broadcast(&_cond);
+   pthread_mutex_unlock(&_lock);
+}
+
+void
+SnapshotWorker::Wait()
+{
+   pthread_mutex_lock(&_lock);
+   while (_busy) {
+      pthread_cond_wait(&_cond, &_lock);
+   }
+   pthread_mutex_unlock(&_lock);
+}
+
+bool
+SnapshotWorker::IsBusy()
+{
+   pthread_mutex_lock(&_lock);
+   bool busy = _busy;
+   pthread_mutex_unlock(&_lock);
+   return busy;
+}
+
+void *
+SnapshotWorker::ThreadProc(void *arg)
+{
+   SnapshotWorker *worker = (SnapshotWorker *)arg;
+
+   pthread_mutex_lock(&worker->_lock);
+   for (;;) {
+      while (!worker->_posted && !worker->_quit) {
+         pthread_cond_wait(&worker->_cond, &worker->_lock);
+      }
+      if (worker->_quit) {
+         break;
+      }
+      worker->_posted = false;
+      pthread_mutex_unlock(&worker->_lock);
+
+      worker->_job(worker->_context);
+
+      pthread_mutex_lock(&worker->_lock);
+      worker->_busy = false;
+      pthread_cond_broadcast(&worker->_cond);
+   }
+   pthread_mutex_unlock(&worker->_lock);
+   return NULL;
+}
@@ -0,0 +1,94 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#include "snapshot_worker.h"
+
+SnapshotWorker::SnapshotWorker() :
+   _job(NULL),
+   _context(NULL),
+   _busy(false),
+   _quit(false),
+   _thread(NULL),
+   _start(NULL),
+   _done(NULL)
+{
+}
+
+SnapshotWorker::~SnapshotWorker()
+{
+   if (_thread) {
+      Wait();
+      _quit = true;
+      SetEvent(_start);
+      WaitForSingleObject(_thread, INFINITE);
+      CloseHandle(_thread);
+   }
+   if (_start) {
+      CloseHandle(_start);
+   }
+   if (_done) {
+      CloseHandle(_done);
+   }
+}
+
+bool
+SnapshotWorker::Start(Job job, void *context)
+{
+   ASSERT(!_thread);
+
+   _job = job;
+   _context = context;
+   _start = CreateEvent(NULL, FALSE, FALSE, NULL);
+   _done = CreateEvent(NULL, FALSE, FALSE, NULL);
+   if (!_start || !_done) {
+      return false;
+   }
+   _thread = CreateThread(NULL, 0, ThreadProc, this, 0, NULL);
+   return _thread != NULL;
+}
+
+void
+SnapshotWorker::Post()
+{
+   ASSERT(!_busy);
+   _busy = true;
+   SetEvent(_start);
+}
+
+void
+SnapshotWorker::Wait()
+{
+   if (_busy) {
+      WaitForSingleObject(_done, INFINITE);
+      _busy = false;
+   }
+}
+
+bool
+SnapshotWorker::IsBusy()
+{
+   if (_busy && WaitForSingleObject(_done, 0) == WAIT_OBJECT_0) {
+      _busy = false;
+   }
+   return _busy;
+}
+
+DWORD WINAPI
+SnapshotWorker::ThreadProc(void *arg)
+{
+   SnapshotWorker *worker = (SnapshotWorker *)arg;
+
+   for (;;) {
+      WaitForSingleObject(worker->_start, INFINITE);
+      if (worker->_quit) {
+         break;
+      }
+      worker->_job(worker->_context);
+      SetEvent(worker->_done);
+   }
+   return 0;
+}
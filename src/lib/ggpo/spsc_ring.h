@@ -0,0 +1,72 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#ifndef _SPSC_RING_H
+#define _SPSC_RING_H
+
+#include <atomic>
+#include "types.h"
+
+#define SPSC_RING_CACHE_LINE     64
+
+/*
+ * A RingBuffer which one thread can push onto while another pops off it,
+ * without locking.  Only one thread may push at a time and only one may
+ * ever pop; pushes from different threads must be ordered by a lock of
+ * their own.  Each side owns one of the indices, which are kept on
+ * separate cache lines so the two threads don't fight over them.  Holds
+ * up to N - 1 items.
+ */
+template<class T, int N> class SpscRing
+{
+public:
+   SpscRing<T, N>() :
+      _head(0),
+      _tail(0) {
+   }
+
+   /*
+    * Producer only.  Returns false if the ring is full.
+    */
+   bool push(const T &t) {
+      int head = _head.load(std::memory_order_relaxed);
+      int next = (head + 1) % N;
+      if (next == _tail.load(std::memory_order_acquire)) {
+         return false;
+      }
+      _elements[head] = t;
+      _head.store(next, std::memory_order_release);
+      return true;
+   }
+
+   /*
+    * Consumer only.  Returns false if the ring is empty.
+    */
+   bool pop(T &t) {
+      int tail = _tail.load(std::memory_order_relaxed);
+      if (tail == _head.load(std::memory_order_acquire)) {
+         return false;
+      }
+      t = _elements[tail];
+      _tail.store((tail + 1) % N, std::memory_order_release);
+      return true;
+   }
+
+   bool empty() {
+      return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire);
+   }
+
+protected:
+   T                 _elements[N];
+   char              _pad0[SPSC_RING_CACHE_LINE];
+   std::atomic<int>  _head;      /* written by the producer */
+   char              _pad1[SPSC_RING_CACHE_LINE - sizeof(std::atomic<int>)];
+   std::atomic<int>  _tail;      /* written by the consumer */
+   char              _pad2[SPSC_RING_CACHE_LINE - sizeof(std::atomic<int>)];
+};
+
+#endif
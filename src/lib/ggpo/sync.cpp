@@ -6,6 +6,8 @@
  */
 
 #include "sync.h"
+#include "delta.h"
+#include "checksum.h"
 
 //Sync::Sync(UdpMsg::connect_status *connect_status) :
 Sync::Sync(SteamMsg::connect_status *connect_status) :
@@ -15,18 +17,45 @@ Sync::Sync(SteamMsg::connect_status *connect_status) :
    _framecount = 0;
    _last_confirmed_frame = -1;
    _max_prediction_frames = 0;
+   _keyframe_interval = 1;
+   _coalesce_rollbacks = false;
+   _pending_rollback_frame = GameInput::NullFrame;
+   _pending_incorrect_inputs = 0;
+   _rollback_budget = 0;
+   _rollback_time_spent = 0;
+   _catchup_frame = GameInput::NullFrame;
+   _save_worker = NULL;
+   _pending_save = -1;
+   _branches = NULL;
+   _num_branches = 0;
+   _branch_capacity = 0;
+   _branch_inputs = NULL;
+   _branch_flags = NULL;
    memset(&_savedstate, 0, sizeof(_savedstate));
+   memset(&_snapshot_stats, 0, sizeof(_snapshot_stats));
 }
 
 Sync::~Sync()
 {
+   WaitForSave();
+   delete _save_worker;
+   FreeBranches();
+
    /*
     * Delete frames manually here rather than in a destructor of the SavedFrame
     * structure so we can efficently copy frames via weak references.
     */
-   for (int i = 0; i < ARRAY_SIZE(_savedstate.frames); i++) {
-      _callbacks.free_buffer(_savedstate.frames[i].buf);
+   for (int i = 0; i < _savedstate.count; i++) {
+      if (_savedstate.mode == GGPO_SNAPSHOT_FULL && !_savedstate.arena) {
+         _callbacks.free_buffer(_savedstate.frames[i].buf);
+      }
+      delete [] _savedstate.frames[i].delta;
    }
+   delete [] _savedstate.frames;
+   delete [] _savedstate.arena;
+   delete [] _savedstate.latest;
+   delete [] _savedstate.scratch;
+   delete _savedstate.pages;
    delete [] _input_queues;
    _input_queues = NULL;
 }
@@ -42,15 +71,312 @@ Sync::Init(Sync::Config &config)
    _max_prediction_frames = config.num_prediction_frames;
 
    CreateQueues(config);
+   AllocateSavedFrames();
+}
+
+bool
+Sync::SetPredictionWindow(int frames)
+{
+   if (frames < 1 || _snapshot_stats.frames_saved) {
+      return false;
+   }
+   _max_prediction_frames = frames;
+   AllocateSavedFrames();
+   return true;
+}
+
+bool
+Sync::SetKeyframeInterval(int interval)
+{
+   if (interval < 1 || _snapshot_stats.frames_saved) {
+      return false;
+   }
+   _keyframe_interval = interval;
+   AllocateSavedFrames();
+   return true;
+}
+
+/*
+ * A rollback never goes back further than the prediction window, so the
+ * ring only needs room for the keyframes in that many frames plus the one
+ * being loaded and the one currently being run.
+ */
+void
+Sync::AllocateSavedFrames()
+{
+   ASSERT(!_snapshot_stats.frames_saved);
+
+   delete [] _savedstate.frames;
+   _savedstate.count = (_max_prediction_frames / _keyframe_interval) + 2;
+   _savedstate.frames = new SavedFrame[_savedstate.count];
+   _savedstate.head = 0;
+
+   if (_savedstate.pages) {
+      /*
+       * The page journals are per slot, so they need to be rebuilt too.
+       */
+      PageSnapshots *pages = new PageSnapshots();
+      pages->Init(_savedstate.pages->GetBase(), _savedstate.pages->GetSize(), _savedstate.count);
+      delete _savedstate.pages;
+      _savedstate.pages = pages;
+   }
+   AllocateSnapshots();
+}
+
+bool
+Sync::SetSnapshotArena(int state_size)
+{
+   if (!_callbacks.save_game_state_into || state_size <= 0) {
+      return false;
+   }
+
+   /*
+    * The arena has to be in place before the first frame is saved, since
+    * from then on the saved frames hold buffers owned by the client.
+    */
+   if (_snapshot_stats.frames_saved) {
+      return false;
+   }
+   _savedstate.arena_slot_size = state_size;
+   AllocateSnapshots();
+   return true;
+}
+
+bool
+Sync::SetSnapshotMode(GGPOSnapshotMode mode)
+{
+   if (mode != GGPO_SNAPSHOT_FULL && mode != GGPO_SNAPSHOT_DELTA && mode != GGPO_SNAPSHOT_PAGES) {
+      return false;
+   }
+   if (mode == GGPO_SNAPSHOT_PAGES && !_savedstate.pages) {
+      return false;
+   }
+   if (_snapshot_stats.frames_saved) {
+      return false;
+   }
+   _savedstate.mode = mode;
+   AllocateSnapshots();
+   return true;
+}
+
+bool
+Sync::SetSnapshotRegion(void *state, int size)
+{
+   if (_snapshot_stats.frames_saved || _savedstate.pages) {
+      return false;
+   }
+   PageSnapshots *pages = new PageSnapshots();
+   if (!pages->Init(state, size, _savedstate.count)) {
+      delete pages;
+      return false;
+   }
+   _savedstate.pages = pages;
+   return SetSnapshotMode(GGPO_SNAPSHOT_PAGES);
+}
+
+bool
+Sync::SetBackgroundSaves(bool enable)
+{
+   if (!enable) {
+      WaitForSave();
+      delete _save_worker;
+      _save_worker = NULL;
+      return true;
+   }
+
+   /*
+    * Only saves into the arena can run on the worker, since the others
+    * need the previous frame or the client's allocator.
+    */
+   if (!_savedstate.arena) {
+      return false;
+   }
+   if (!_save_worker) {
+      _save_worker = new SnapshotWorker();
+      if (!_save_worker->Start(RunBackgroundSave, this)) {
+         delete _save_worker;
+         _save_worker = NULL;
+         return false;
+      }
+   }
+   return true;
+}
+
+bool
+Sync::SetSpeculation(int branches)
+{
+   if (branches < 0 || branches > GGPO_MAX_SPECULATIVE_BRANCHES) {
+      return false;
+   }
+   if (branches && (!_callbacks.advance_state || !_savedstate.arena)) {
+      return false;
+   }
+   _num_branches = branches;
+   return AllocateBranches();
+}
+
+/*
+ * Each branch gets its own copy of the state plus room for the keyframes
+ * and inputs between the oldest frame a rollback can go back to and the
+ * current one.
+ */
+bool
+Sync::AllocateBranches()
+{
+   FreeBranches();
+   if (!_num_branches || !_savedstate.arena) {
+      return true;
+   }
+
+   int stride = _config.num_players * _config.input_size;
+   int slot_size = _savedstate.arena_slot_size;
+   _branch_capacity = _max_prediction_frames + _keyframe_interval;
+   _branch_inputs = new ggpo::byte[_branch_capacity * stride];
+   _branch_flags = new int[_branch_capacity];
+   _branches = new Branch[_num_branches];
+   memset(_branches, 0, _num_branches * sizeof(Branch));
+   for (int i = 0; i < _num_branches; i++) {
+      Branch *branch = _branches + i;
+      branch->sync = this;
+      branch->queue = -1;
+      branch->state = new ggpo::byte[slot_size];
+      branch->keyframes = new ggpo::byte[slot_size * _savedstate.count];
+      branch->inputs = new ggpo::byte[_branch_capacity * stride];
+      branch->disconnect_flags = new int[_branch_capacity];
+      branch->worker = new SnapshotWorker();
+      if (!branch->worker->Start(RunBranch, branch)) {
+         FreeBranches();
+         return false;
+      }
+   }
+   Log("Allocated %d speculative branches.\n", _num_branches);
+   return true;
+}
+
+void
+Sync::FreeBranches()
+{
+   for (int i = 0; i < _num_branches && _branches; i++) {
+      Branch *branch = _branches + i;
+      delete branch->worker;
+      delete [] branch->state;
+      delete [] branch->keyframes;
+      delete [] branch->inputs;
+      delete [] branch->disconnect_flags;
+   }
+   delete [] _branches;
+   delete [] _branch_inputs;
+   delete [] _branch_flags;
+   _branches = NULL;
+   _branch_inputs = NULL;
+   _branch_flags = NULL;
+}
+
+bool
+Sync::SetInputPredictor(GGPOInputPredictor predictor)
+{
+   if (predictor < 0 || predictor >= GGPO_NUM_INPUT_PREDICTORS) {
+      return false;
+   }
+   if (_snapshot_stats.frames_saved) {
+      return false;
+   }
+   for (int i = 0; i < _config.num_players; i++) {
+      _input_queues[i].SetPredictor(predictor);
+   }
+   return true;
+}
+
+bool
+Sync::SetPredictorComparison(bool enable)
+{
+   if (_snapshot_stats.frames_saved) {
+      return false;
+   }
+   for (int i = 0; i < _config.num_players; i++) {
+      _input_queues[i].SetPredictorComparison(enable);
+   }
+   return true;
+}
+
+bool
+Sync::SetInputRelevance(int queue, void *mask, int size)
+{
+   if (mask && size != _config.input_size) {
+      return false;
+   }
+   _input_queues[queue].SetRelevance((char *)mask);
+   return true;
+}
+
+void
+Sync::GetSnapshotStats(GGPOSnapshotStats *stats)
+{
+   WaitForSave();
+   *stats = _snapshot_stats;
+}
+
+void
+Sync::GetPredictionStats(int queue, GGPOPredictionStats *stats)
+{
+   _input_queues[queue].GetPredictionStats(stats);
+}
+
+void
+Sync::GetMispredictionStats(int queue, GGPOMispredictionStats *stats)
+{
+   _input_queues[queue].GetMispredictionStats(stats);
+}
+
+void
+Sync::AllocateSnapshots()
+{
+   delete [] _savedstate.arena;
+   delete [] _savedstate.latest;
+   delete [] _savedstate.scratch;
+   _savedstate.arena = _savedstate.latest = _savedstate.scratch = NULL;
+   _savedstate.latest_capacity = 0;
+   for (int i = 0; i < _savedstate.count; i++) {
+      _savedstate.frames[i].buf = NULL;
+   }
+   FreeBranches();
+
+   int state_size = _savedstate.arena_slot_size;
+   if (!state_size || _savedstate.mode == GGPO_SNAPSHOT_PAGES) {
+      return;
+   }
+   if (_savedstate.mode == GGPO_SNAPSHOT_DELTA) {
+      /*
+       * Delta snapshots only ever hold one full copy of the state, plus a
+       * scratch buffer for the client to serialize the next one into.
+       */
+      _savedstate.latest = new ggpo::byte[state_size];
+      _savedstate.latest_capacity = state_size;
+      memset(_savedstate.latest, 0, state_size);
+      _savedstate.scratch = new ggpo::byte[state_size];
+   } else {
+      _savedstate.arena = new ggpo::byte[state_size * _savedstate.count];
+      for (int i = 0; i < _savedstate.count; i++) {
+         _savedstate.frames[i].buf = _savedstate.arena + (i * state_size);
+      }
+      AllocateBranches();
+   }
+   Log("Allocated snapshot buffers (%d slots of %d bytes, mode %d).\n", _savedstate.count, state_size, _savedstate.mode);
 }
 
 void
 Sync::SetLastConfirmedFrame(int frame) 
 {   
    _last_confirmed_frame = frame;
-   if (_last_confirmed_frame > 0) {
+
+   /*
+    * Hang on to the inputs back to the keyframe a rollback to this frame
+    * would start from.
+    */
+   int discard = frame - (frame % _keyframe_interval) - 1;
+   if (discard >= 0) {
       for (int i = 0; i < _config.num_players; i++) {
-         _input_queues[i].DiscardConfirmedFrames(frame - 1);
+         _input_queues[i].DiscardConfirmedFrames(discard);
       }
    }
 }
@@ -58,6 +384,21 @@ Sync::SetLastConfirmedFrame(int frame)
 bool
 Sync::AddLocalInput(int queue, GameInput &input)
 {
+   /*
+    * This is the start of a new frame, so the rollback budget starts over.
+    * Finish off any rollback which didn't fit in the last one before
+    * accepting more input.
+    */
+   _rollback_time_spent = 0;
+   RunPendingRollback();
+   if (_catchup_frame != GameInput::NullFrame) {
+      CatchUp();
+      if (_catchup_frame != GameInput::NullFrame) {
+         Log("Rejecting input from emulator: still catching up to frame %d.\n", _catchup_frame);
+         return false;
+      }
+   }
+
    int frames_behind = _framecount - _last_confirmed_frame; 
    if (_framecount >= _max_prediction_frames && frames_behind >= _max_prediction_frames) {
       Log("Rejecting input from emulator: reached prediction barrier.\n");
@@ -81,30 +422,62 @@ Sync::AddRemoteInput(int queue, GameInput &input)
    _input_queues[queue].AddInput(input);
 }
 
+/*
+ * Copies the confirmed input of every player for count frames starting at
+ * first into values, one frame after another, and returns how many frames
+ * were copied.  A disconnected player's input is zeroed after their last
+ * frame, and their bit is set in that frame's disconnect_flags (which may
+ * be NULL).
+ */
 int
-Sync::GetConfirmedInputs(void *values, int size, int frame)
+Sync::GetConfirmedInputs(int first, int count, void *values, int size, int *disconnect_flags)
 {
-   int disconnect_flags = 0;
+   int frame_size = _config.num_players * _config.input_size;
+   int live[GGPO_MAX_PLAYERS];
    char *output = (char *)values;
 
-   ASSERT(size >= _config.num_players * _config.input_size);
+   ASSERT(size >= count * frame_size);
 
-   memset(output, 0, size);
    for (int i = 0; i < _config.num_players; i++) {
-      GameInput input;
-      if (_local_connect_status[i].disconnected && frame > _local_connect_status[i].last_frame) {
-         disconnect_flags |= (1 << i);
-         input.erase();
-      } else {
-         _input_queues[i].GetConfirmedInput(frame, &input);
+      live[i] = count;
+      if (_local_connect_status[i].disconnected) {
+         live[i] = MAX(0, MIN(count, _local_connect_status[i].last_frame - first + 1));
+      }
+      int copied = _input_queues[i].GetConfirmedInputs(first, live[i], output + (i * _config.input_size), frame_size);
+      if (copied < live[i]) {
+         count = copied;
       }
-      memcpy(output + (i * _config.input_size), input.bits, _config.input_size);
    }
-   return disconnect_flags;
+
+   for (int f = 0; f < count; f++) {
+      int flags = 0;
+      for (int i = 0; i < _config.num_players; i++) {
+         if (f >= live[i]) {
+            flags |= (1 << i);
+            memset(output + (f * frame_size) + (i * _config.input_size), 0, _config.input_size);
+         }
+      }
+      if (disconnect_flags) {
+         disconnect_flags[f] = flags;
+      }
+   }
+   return count;
 }
 
 int
 Sync::SynchronizeInputs(void *values, int size)
+{
+   /*
+    * The game is about to start changing its state again.
+    */
+   WaitForSave();
+   RunPendingRollback();
+
+   return GetFrameInputs(_framecount, values, size);
+}
+
+int
+Sync::GetFrameInputs(int frame, void *values, int size)
 {
    int disconnect_flags = 0;
    char *output = (char *)values;
@@ -114,11 +487,11 @@ Sync::SynchronizeInputs(void *values, int size)
    memset(output, 0, size);
    for (int i = 0; i < _config.num_players; i++) {
       GameInput input;
-      if (_local_connect_status[i].disconnected && _framecount > _local_connect_status[i].last_frame) {
+      if (_local_connect_status[i].disconnected && frame > _local_connect_status[i].last_frame) {
          disconnect_flags |= (1 << i);
          input.erase();
       } else {
-         _input_queues[i].GetInput(_framecount, &input);
+         _input_queues[i].GetInput(frame, &input);
       }
       memcpy(output + (i * _config.input_size), input.bits, _config.input_size);
    }
@@ -130,50 +503,391 @@ Sync::CheckSimulation(int timeout)
 {
    int seek_to;
    if (!CheckSimulationConsistency(&seek_to)) {
-      AdjustSimulation(seek_to);
+      if (_coalesce_rollbacks) {
+         DeferRollback(seek_to);
+      } else {
+         AdjustSimulation(seek_to);
+      }
+   } else if (_catchup_frame != GameInput::NullFrame) {
+      CatchUp();
+   } else if (_pending_rollback_frame == GameInput::NullFrame) {
+      Speculate();
+   }
+}
+
+/*
+ * Notes that we need to roll back to seek_to before the game asks for its
+ * next inputs.  If more incorrect inputs have shown up since the rollback
+ * was first deferred, the default behavior would have rolled back again
+ * for them, so count that as a rollback saved.
+ */
+void
+Sync::DeferRollback(int seek_to)
+{
+   int incorrect = GetIncorrectInputCount();
+
+   if (_pending_rollback_frame == GameInput::NullFrame) {
+      Log("deferring rollback to frame %d.\n", seek_to);
+   } else if (incorrect != _pending_incorrect_inputs) {
+      Log("coalescing rollback to frame %d into pending rollback.\n", seek_to);
+      _snapshot_stats.rollbacks_coalesced++;
+   }
+   _pending_rollback_frame = seek_to;
+   _pending_incorrect_inputs = incorrect;
+}
+
+void
+Sync::RunPendingRollback()
+{
+   if (_pending_rollback_frame != GameInput::NullFrame && !_rollingback) {
+      AdjustSimulation(_pending_rollback_frame);
+   }
+}
+
+int
+Sync::GetIncorrectInputCount()
+{
+   int count = 0;
+   for (int i = 0; i < _config.num_players; i++) {
+      count += _input_queues[i].GetIncorrectInputCount();
    }
+   return count;
 }
 
 void
 Sync::IncrementFrame(void)
 {
    _framecount++;
-   SaveCurrentFrame();
+   if (_framecount % _keyframe_interval == 0) {
+      SaveCurrentFrame();
+   }
+
+   /*
+    * Get the branches started on this frame while the game renders, so
+    * they're caught up by the time the next inputs arrive.
+    */
+   if (!_rollingback && _pending_rollback_frame == GameInput::NullFrame) {
+      Speculate();
+   }
 }
 
 void
 Sync::AdjustSimulation(int seek_to)
 {
-   int framecount = _framecount;
-   int count = _framecount - seek_to;
+   /*
+    * If an earlier rollback hasn't finished yet, this one needs to run all
+    * the way to where that one was headed.
+    */
+   int framecount = MAX(_framecount, _catchup_frame);
 
    Log("Catching up\n");
    _rollingback = true;
 
+   /*
+    * Fold in any rollback which was waiting to run.
+    */
+   if (_pending_rollback_frame != GameInput::NullFrame) {
+      seek_to = MIN(seek_to, _pending_rollback_frame);
+      _pending_rollback_frame = GameInput::NullFrame;
+   }
+
+   /*
+    * Only keyframes are saved, so start from the closest one before
+    * seek_to and re-run the correctly predicted frames in between too.
+    */
+   if (seek_to < _framecount) {
+      seek_to -= seek_to % _keyframe_interval;
+   }
+
+   /*
+    * Note whose mispredictions this rollback is for before anything
+    * resets the queues.
+    */
+   int mispredicted = 0;
+   for (int i = 0; i < _config.num_players; i++) {
+      if (_input_queues[i].GetFirstIncorrectFrame() != GameInput::NullFrame) {
+         mispredicted |= (1 << i);
+      }
+   }
+
+   /*
+    * One of the speculative branches may have already run these frames
+    * with the right inputs.  Either way they're no good after this.
+    */
+   bool used_branch = _catchup_frame == GameInput::NullFrame && UseBranch(seek_to);
+   DiscardBranches();
+   if (used_branch) {
+      _rollingback = false;
+      Log("---\n");
+      return;
+   }
+
    /*
     * Flush our input queue and load the last frame.
     */
    LoadFrame(seek_to);
    ASSERT(_framecount == seek_to);
 
+   for (int i = 0; i < _config.num_players; i++) {
+      if (mispredicted & (1 << i)) {
+         _input_queues[i].RecordRollback(framecount - seek_to);
+      }
+   }
+   ResetPrediction(_framecount);
+   _catchup_frame = framecount;
+   CatchUp();
+   if (_catchup_frame != GameInput::NullFrame) {
+      _snapshot_stats.rollbacks_spread++;
+   }
+
+   Log("---\n");   
+}
+
+void
+Sync::CatchUp()
+{
+   ggpo::uint32 start = Platform::GetCurrentTimeUS();
+   ggpo::uint32 longest = 0;
+   bool out_of_time = false;
+   int frames = 0;
+
    /*
     * Advance frame by frame (stuffing notifications back to 
-    * the master).
+    * the master).  With a budget set, stop once it looks like the next
+    * frame won't fit, but always make some progress.
     */
-   ResetPrediction(_framecount);
-   for (int i = 0; i < count; i++) {
+   _rollingback = true;
+   while (_framecount < _catchup_frame) {
+      ggpo::uint32 now = Platform::GetCurrentTimeUS();
+      if (_rollback_budget && frames && _rollback_time_spent + (now - start) + longest > (ggpo::uint32)_rollback_budget) {
+         out_of_time = true;
+         break;
+      }
       _callbacks.advance_frame(0);
+      longest = MAX(longest, Platform::GetCurrentTimeUS() - now);
+      frames++;
    }
-   ASSERT(_framecount == framecount);
-
+   _rollback_time_spent += Platform::GetCurrentTimeUS() - start;
    _rollingback = false;
 
-   Log("---\n");   
+   if (out_of_time) {
+      Log("Out of time at frame %d.  Catching up to %d later.\n", _framecount, _catchup_frame);
+   } else {
+      ASSERT(_framecount == _catchup_frame);
+      _catchup_frame = GameInput::NullFrame;
+   }
+}
+
+/*
+ * Keeps the speculative branches going.  While we're predicting a remote
+ * player's input, each branch takes a copy of the saved state from before
+ * the prediction started, guesses that the player switched to one of
+ * their recent inputs instead, and runs the game forward from there on a
+ * worker thread.  Branches are only restarted when the prediction moves
+ * on; otherwise they're just run up to the current frame.
+ */
+void
+Sync::Speculate()
+{
+   if (!_branches || !_savedstate.arena) {
+      return;
+   }
+
+   /*
+    * Guess at the player we've been predicting the longest.
+    */
+   int queue = -1;
+   int frame = _framecount;
+   for (int i = 0; i < _config.num_players; i++) {
+      if (_local_connect_status[i].disconnected) {
+         continue;
+      }
+      int next = _input_queues[i].GetLastConfirmedFrame() + 1;
+      if (next < frame) {
+         queue = i;
+         frame = next;
+      }
+   }
+   if (queue == -1) {
+      return;
+   }
+
+   int start = frame - (frame % _keyframe_interval);
+   SavedFrame *saved = _savedstate.frames + ((start / _keyframe_interval) % _savedstate.count);
+   if (saved->frame != start || _framecount - start > _branch_capacity) {
+      return;
+   }
+
+   GameInput guesses[GGPO_MAX_SPECULATIVE_BRANCHES];
+   int num_guesses = -1;
+   for (int i = 0; i < _num_branches; i++) {
+      Branch *branch = _branches + i;
+      if (branch->worker->IsBusy()) {
+         continue;
+      }
+      if (branch->queue != queue || branch->frame != frame) {
+         if (num_guesses < 0) {
+            num_guesses = _input_queues[queue].GetRecentInputs(guesses, _num_branches);
+         }
+         branch->queue = queue;
+         branch->frame = frame;
+         branch->live = i < num_guesses;
+         if (!branch->live) {
+            continue;
+         }
+         branch->guess = guesses[i];
+         branch->start = branch->end = start;
+         branch->cstate = saved->cbuf;
+         memcpy(branch->state, saved->buf, saved->cbuf);
+         Log("starting branch %d at frame %d (queue %d from frame %d).\n", i, start, queue, frame);
+      }
+      if (!branch->live || branch->end == GameInput::NullFrame || branch->end >= _framecount) {
+         continue;
+      }
+      for (int f = branch->end; f < _framecount && branch->live; f++) {
+         branch->live = PeekFrameInputs(f, branch);
+      }
+      if (branch->live) {
+         branch->target = _framecount;
+         branch->worker->Post();
+      }
+   }
+}
+
+/*
+ * Fills in the branch's inputs for frame the way SynchronizeInputs would,
+ * except for the guess.
+ */
+bool
+Sync::PeekFrameInputs(int frame, Branch *branch)
+{
+   int stride = _config.num_players * _config.input_size;
+   int index = frame - branch->start;
+   char *output = (char *)branch->inputs + (index * stride);
+   int disconnect_flags = 0;
+
+   for (int i = 0; i < _config.num_players; i++) {
+      GameInput input;
+      if (_local_connect_status[i].disconnected && frame > _local_connect_status[i].last_frame) {
+         disconnect_flags |= (1 << i);
+         input.erase();
+      } else if (i == branch->queue && frame >= branch->frame) {
+         input = branch->guess;
+      } else if (!_input_queues[i].PeekInput(frame, &input)) {
+         return false;
+      }
+      memcpy(output + (i * _config.input_size), input.bits, _config.input_size);
+   }
+   branch->disconnect_flags[index] = disconnect_flags;
+   return true;
+}
+
+void
+Sync::RunBranch(void *context)
+{
+   Branch *branch = (Branch *)context;
+   Sync *sync = branch->sync;
+   int stride = sync->_config.num_players * sync->_config.input_size;
+   int slot_size = sync->_savedstate.arena_slot_size;
+   int interval = sync->_keyframe_interval;
+
+   for (int frame = branch->end; frame < branch->target; frame++) {
+      int index = frame - branch->start;
+      if (!sync->_callbacks.advance_state(branch->state, branch->cstate, branch->inputs + (index * stride), stride, branch->disconnect_flags[index])) {
+         branch->end = GameInput::NullFrame;
+         return;
+      }
+      if ((frame + 1) % interval == 0) {
+         int slot = ((frame + 1) / interval) % sync->_savedstate.count;
+         memcpy(branch->keyframes + (slot * slot_size), branch->state, branch->cstate);
+      }
+   }
+   branch->end = branch->target;
+}
+
+/*
+ * Looks for a branch which started at seek_to and got every input since
+ * right, and if there is one, swaps in its state and keyframes.  Checking
+ * the inputs pulls them from the queues exactly as re-running the frames
+ * would, so a failed check leaves nothing to undo.
+ */
+bool
+Sync::UseBranch(int seek_to)
+{
+   if (!_branches) {
+      return false;
+   }
+
+   int num_frames = _framecount - seek_to;
+   int stride = _config.num_players * _config.input_size;
+   bool checked = false;
+   Branch *found = NULL;
+   for (int i = 0; i < _num_branches && !found; i++) {
+      Branch *branch = _branches + i;
+      if (!branch->live || branch->start != seek_to) {
+         continue;
+      }
+      branch->worker->Wait();
+      if (branch->end != _framecount) {
+         continue;
+      }
+      if (!checked) {
+         ResetPrediction(seek_to);
+         for (int f = 0; f < num_frames; f++) {
+            _branch_flags[f] = GetFrameInputs(seek_to + f, _branch_inputs + (f * stride), stride);
+         }
+         checked = true;
+      }
+      if (!memcmp(branch->inputs, _branch_inputs, num_frames * stride) &&
+          !memcmp(branch->disconnect_flags, _branch_flags, num_frames * sizeof(int))) {
+         found = branch;
+      }
+   }
+   if (!found) {
+      if (checked) {
+         _snapshot_stats.speculative_misses++;
+      }
+      return false;
+   }
+
+   Log("=== Using branch for frames %d to %d.\n", seek_to, _framecount);
+   WaitForSave();
+   for (int frame = seek_to + _keyframe_interval; frame <= _framecount; frame += _keyframe_interval) {
+      int i = (frame / _keyframe_interval) % _savedstate.count;
+      SavedFrame *state = _savedstate.frames + i;
+      memcpy(state->buf, found->keyframes + (i * _savedstate.arena_slot_size), found->cstate);
+      state->frame = frame;
+      state->cbuf = found->cstate;
+      state->checksum = (int)Checksum_Crc32c(state->buf, state->cbuf);
+   }
+   _callbacks.load_game_state(found->state, found->cstate);
+   _snapshot_stats.frames_loaded++;
+   _snapshot_stats.bytes_loaded += found->cstate;
+   _snapshot_stats.speculative_hits++;
+   return true;
+}
+
+/*
+ * Branches which are still running are left to finish; Speculate won't
+ * touch them until they have.
+ */
+void
+Sync::DiscardBranches()
+{
+   for (int i = 0; i < _num_branches && _branches; i++) {
+      _branches[i].live = false;
+      _branches[i].queue = -1;
+   }
 }
 
 void
 Sync::LoadFrame(int frame)
 {
+   /*
+    * Loading overwrites the state a background save may still be copying.
+    */
+   WaitForSave();
+
    // find the frame in question
    if (frame == _framecount) {
       Log("Skipping NOP.\n");
@@ -181,19 +895,28 @@ Sync::LoadFrame(int frame)
    }
 
    // Move the head pointer back and load it up
-   _savedstate.head = FindSavedFrameIndex(frame);
-   SavedFrame *state = _savedstate.frames + _savedstate.head;
+   int i = FindSavedFrameIndex(frame);
+   SavedFrame *state = _savedstate.frames + i;
+   if (_savedstate.mode == GGPO_SNAPSHOT_DELTA) {
+      RebuildDeltaFrame(i);
+      _snapshot_stats.bytes_loaded += state->cbuf;
+   } else if (_savedstate.mode == GGPO_SNAPSHOT_PAGES) {
+      RebuildPageFrame(i);
+   } else {
+      _snapshot_stats.bytes_loaded += state->cbuf;
+   }
 
    Log("=== Loading frame info %d (size: %d  checksum: %08x).\n",
        state->frame, state->cbuf, state->checksum);
 
    ASSERT(state->buf && state->cbuf);
    _callbacks.load_game_state(state->buf, state->cbuf);
+   _snapshot_stats.frames_loaded++;
 
    // Reset framecount and the head of the state ring-buffer to point in
    // advance of the current frame (as if we had just finished executing it).
    _framecount = state->frame;
-   _savedstate.head = (_savedstate.head + 1) % ARRAY_SIZE(_savedstate.frames);
+   _savedstate.head = (i + 1) % _savedstate.count;
 }
 
 void
@@ -201,26 +924,233 @@ Sync::SaveCurrentFrame()
 {
    /*
     * See StateCompress for the real save feature implemented by FinalBurn.
-    * Write everything into the head, then advance the head pointer.
+    * Write everything into the slot for this frame, then point the head
+    * just past it.
     */
-   SavedFrame *state = _savedstate.frames + _savedstate.head;
-   if (state->buf) {
-      _callbacks.free_buffer(state->buf);
-      state->buf = NULL;
-   }
+   ASSERT(_framecount % _keyframe_interval == 0);
+   WaitForSave();
+   int i = (_framecount / _keyframe_interval) % _savedstate.count;
+   SavedFrame *state = _savedstate.frames + i;
    state->frame = _framecount;
-   _callbacks.save_game_state(&state->buf, &state->cbuf, &state->checksum, state->frame);
+   state->checksum = 0;
+   if (_savedstate.mode == GGPO_SNAPSHOT_DELTA) {
+      SaveDeltaFrame(state);
+   } else if (_savedstate.mode == GGPO_SNAPSHOT_PAGES) {
+      SavePageFrame(state);
+   } else if (_savedstate.arena) {
+      /*
+       * The slot buffers live in the arena, so have the client serialize
+       * straight into them rather than handing us a fresh allocation.
+       */
+      state->cbuf = 0;
+      if (_save_worker) {
+         /*
+          * The game leaves its state alone until it asks for the next
+          * frame's inputs, so the copy can run on the worker while the
+          * game renders.  WaitForSave does the rest of the bookkeeping.
+          */
+         _pending_save = i;
+         _save_worker->Post();
+      } else {
+         SaveArenaFrame(state);
+         ASSERT(state->cbuf > 0 && state->cbuf <= _savedstate.arena_slot_size);
+         _snapshot_stats.bytes_saved += state->cbuf;
+      }
+   } else {
+      if (state->buf) {
+         _callbacks.free_buffer(state->buf);
+         state->buf = NULL;
+      }
+      _callbacks.save_game_state(&state->buf, &state->cbuf, &state->checksum, state->frame);
+      if (!state->checksum) {
+         state->checksum = (int)Checksum_Crc32c(state->buf, state->cbuf);
+      }
+      _snapshot_stats.bytes_saved += state->cbuf;
+   }
+   _snapshot_stats.frames_saved++;
+
+   if (_pending_save == -1) {
+      Log("=== Saved frame info %d (size: %d  checksum: %08x).\n", state->frame, state->cbuf, state->checksum);
+   }
+   _savedstate.head = (i + 1) % _savedstate.count;
+}
+
+/*
+ * Has the client serialize straight into the slot's arena buffer.  Runs
+ * on the save worker when background saves are on, so it mustn't touch
+ * anything but the slot.
+ */
+void
+Sync::SaveArenaFrame(SavedFrame *state)
+{
+   _callbacks.save_game_state_into(state->buf, _savedstate.arena_slot_size, &state->cbuf, &state->checksum, state->frame);
+   if (!state->checksum && state->cbuf > 0) {
+      state->checksum = (int)Checksum_Crc32c(state->buf, state->cbuf);
+   }
+}
+
+void
+Sync::RunBackgroundSave(void *context)
+{
+   Sync *sync = (Sync *)context;
+   sync->SaveArenaFrame(sync->_savedstate.frames + sync->_pending_save);
+}
+
+/*
+ * Blocks until the save running on the worker, if any, is finished.  Must
+ * be called before anything which writes the game state or reads the slot.
+ */
+void
+Sync::WaitForSave()
+{
+   if (_pending_save == -1) {
+      return;
+   }
+   _save_worker->Wait();
+
+   SavedFrame *state = _savedstate.frames + _pending_save;
+   _pending_save = -1;
+   ASSERT(state->cbuf > 0 && state->cbuf <= _savedstate.arena_slot_size);
+   _snapshot_stats.bytes_saved += state->cbuf;
+   Log("=== Saved frame info %d (size: %d  checksum: %08x) in the background.\n", state->frame, state->cbuf, state->checksum);
+}
+
+/*
+ * In delta mode only the most recently saved frame is kept in full, in
+ * _savedstate.latest.  Every older frame stores the XOR delta between
+ * itself and the frame saved after it, so saving a frame costs a compare
+ * against the last one plus however many bytes actually changed.
+ */
+void
+Sync::SaveDeltaFrame(SavedFrame *state)
+{
+   ggpo::byte *buf = NULL;
+   int len = 0;
+
+   if (_savedstate.scratch) {
+      buf = _savedstate.scratch;
+      _callbacks.save_game_state_into(buf, _savedstate.arena_slot_size, &len, &state->checksum, state->frame);
+      ASSERT(len > 0 && len <= _savedstate.arena_slot_size);
+   } else {
+      _callbacks.save_game_state(&buf, &len, &state->checksum, state->frame);
+   }
+   ASSERT(buf && len);
+   if (!state->checksum) {
+      state->checksum = (int)Checksum_Crc32c(buf, len);
+   }
+
+   if (len > _savedstate.latest_capacity) {
+      ggpo::byte *latest = new ggpo::byte[len];
+      memset(latest, 0, len);
+      if (_savedstate.latest) {
+         memcpy(latest, _savedstate.latest, _savedstate.latest_capacity);
+         delete [] _savedstate.latest;
+      }
+      _savedstate.latest = latest;
+      _savedstate.latest_capacity = len;
+   }
+
+   SavedFrame *prev = &GetLastSavedFrame();
+   if (prev->buf) {
+      /*
+       * Turn the previous frame into a delta against this one, growing its
+       * delta buffer if it's too small, then patch the full copy forward.
+       */
+      int cdelta = Delta_Encode(prev->delta, prev->delta_capacity, _savedstate.latest, prev->cbuf, buf, len);
+      if (cdelta > prev->delta_capacity) {
+         delete [] prev->delta;
+         prev->delta_capacity = cdelta + (cdelta / 4);
+         prev->delta = new ggpo::byte[prev->delta_capacity];
+         Delta_Encode(prev->delta, prev->delta_capacity, _savedstate.latest, prev->cbuf, buf, len);
+      }
+      prev->cdelta = cdelta;
+      prev->buf = NULL;
+      Delta_Apply(_savedstate.latest, prev->delta, prev->cdelta);
+      _snapshot_stats.bytes_saved += cdelta;
+   } else {
+      memcpy(_savedstate.latest, buf, len);
+      _snapshot_stats.bytes_saved += len;
+   }
 
-   Log("=== Saved frame info %d (size: %d  checksum: %08x).\n", state->frame, state->cbuf, state->checksum);
-   _savedstate.head = (_savedstate.head + 1) % ARRAY_SIZE(_savedstate.frames);
+   if (buf != _savedstate.scratch) {
+      _callbacks.free_buffer(buf);
+   }
+   state->buf = _savedstate.latest;
+   state->cbuf = len;
+   state->cdelta = 0;
+}
+
+/*
+ * Walks the deltas back from the most recently saved frame to the one at
+ * index, leaving it in _savedstate.latest.
+ */
+void
+Sync::RebuildDeltaFrame(int index)
+{
+   int count = _savedstate.count;
+   int i = (_savedstate.head + count - 1) % count;
+
+   while (i != index) {
+      _savedstate.frames[i].buf = NULL;
+      i = (i + count - 1) % count;
+      SavedFrame *state = _savedstate.frames + i;
+      Delta_Apply(_savedstate.latest, state->delta, state->cdelta);
+      _snapshot_stats.bytes_loaded += state->cdelta;
+   }
+   _savedstate.frames[index].buf = _savedstate.latest;
+   _savedstate.frames[index].cdelta = 0;
+}
+
+/*
+ * In page mode the client's state lives in a region registered with
+ * SetSnapshotRegion, and PageSnapshots saves it by copying out the pages
+ * which changed since the last save.  Like delta mode, older frames hold
+ * what's needed to step back from the frame saved after them, so only
+ * the most recent frame has a buf.  The checksum still covers the whole
+ * region, so synctest can compare it like any other mode's.
+ */
+void
+Sync::SavePageFrame(SavedFrame *state)
+{
+   PageSnapshots *pages = _savedstate.pages;
+   SavedFrame *prev = &GetLastSavedFrame();
+   int prev_index = (prev->buf && prev != state) ? (int)(prev - _savedstate.frames) : -1;
+
+   _snapshot_stats.bytes_saved += pages->Save(_savedstate.head, prev_index);
+   prev->buf = NULL;
+   state->buf = pages->GetBase();
+   state->cbuf = pages->GetSize();
+   state->checksum = (int)Checksum_Crc32c(state->buf, state->cbuf);
+}
+
+/*
+ * Undoes the client's writes since the last save or load, then walks the
+ * page journals back to the frame at index.
+ */
+void
+Sync::RebuildPageFrame(int index)
+{
+   PageSnapshots *pages = _savedstate.pages;
+   int count = _savedstate.count;
+   int i = (_savedstate.head + count - 1) % count;
+
+   _snapshot_stats.bytes_loaded += pages->Revert();
+   while (i != index) {
+      _savedstate.frames[i].buf = NULL;
+      i = (i + count - 1) % count;
+      _snapshot_stats.bytes_loaded += pages->Rewind(i);
+   }
+   pages->ClearDirty();
+   _savedstate.frames[index].buf = pages->GetBase();
 }
 
 Sync::SavedFrame&
 Sync::GetLastSavedFrame()
 {
+   WaitForSave();
    int i = _savedstate.head - 1;
    if (i < 0) {
-      i = ARRAY_SIZE(_savedstate.frames) - 1;
+      i = _savedstate.count - 1;
    }
    return _savedstate.frames[i];
 }
@@ -229,13 +1159,9 @@ Sync::GetLastSavedFrame()
 int
 Sync::FindSavedFrameIndex(int frame)
 {
-   int i, count = ARRAY_SIZE(_savedstate.frames);
-   for (i = 0; i < count; i++) {
-      if (_savedstate.frames[i].frame == frame) {
-         break;
-      }
-   }
-   if (i == count) {
+   ASSERT(frame >= 0 && frame % _keyframe_interval == 0);
+   int i = (frame / _keyframe_interval) % _savedstate.count;
+   if (_savedstate.frames[i].frame != frame) {
       ASSERT(FALSE);
    }
    return i;
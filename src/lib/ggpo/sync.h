@@ -13,11 +13,11 @@
 #include "game_input.h"
 #include "input_queue.h"
 #include "ring_buffer.h"
+#include "page_snapshot.h"
+#include "snapshot_worker.h"
 //#include "network/udp_msg.h"
 #include "network/steam_msg.h"
 
-#define MAX_PREDICTION_FRAMES    8
-
 class SyncTestBackend;
 
 class Sync {
@@ -46,11 +46,26 @@ public:
 
    void Init(Config &config);
 
+   bool SetPredictionWindow(int frames);
+   bool SetKeyframeInterval(int interval);
+   void SetRollbackCoalescing(bool enable) { _coalesce_rollbacks = enable; }
+   void SetRollbackBudget(int budget) { _rollback_budget = budget; }
+   bool SetSnapshotArena(int state_size);
+   bool SetSnapshotMode(GGPOSnapshotMode mode);
+   bool SetSnapshotRegion(void *state, int size);
+   bool SetBackgroundSaves(bool enable);
+   bool SetSpeculation(int branches);
+   bool SetInputPredictor(GGPOInputPredictor predictor);
+   bool SetPredictorComparison(bool enable);
+   bool SetInputRelevance(int queue, void *mask, int size);
+   void GetSnapshotStats(GGPOSnapshotStats *stats);
+   void GetPredictionStats(int queue, GGPOPredictionStats *stats);
+   void GetMispredictionStats(int queue, GGPOMispredictionStats *stats);
    void SetLastConfirmedFrame(int frame);
    void SetFrameDelay(int queue, int delay);
    bool AddLocalInput(int queue, GameInput &input);
    void AddRemoteInput(int queue, GameInput &input);
-   int GetConfirmedInputs(void *values, int size, int frame);
+   int GetConfirmedInputs(int first, int count, void *values, int size, int *disconnect_flags);
    int SynchronizeInputs(void *values, int size);
 
    void CheckSimulation(int timeout);
@@ -58,6 +73,7 @@ public:
    void IncrementFrame(void);
 
    int GetFrameCount() { return _framecount; }
+   int GetPendingRollbackFrame() { return _pending_rollback_frame; }
    bool InRollback() { return _rollingback; }
 
    bool GetEvent(Event &e);
@@ -70,31 +86,98 @@ protected:
       int      cbuf;
       int      frame;
       int      checksum;
-      SavedFrame() : buf(NULL), cbuf(0), frame(-1), checksum(0) { }
+      ggpo::byte    *delta;   /* delta mode: XOR against the next saved frame */
+      int      cdelta;
+      int      delta_capacity;
+      SavedFrame() : buf(NULL), cbuf(0), frame(-1), checksum(0), delta(NULL), cdelta(0), delta_capacity(0) { }
+   };
+   struct Branch {
+      Sync           *sync;
+      SnapshotWorker *worker;
+      bool           live;
+      int            queue;      /* the queue whose input is being guessed */
+      int            frame;      /* the first frame guess is used for */
+      GameInput      guess;
+      int            start;      /* the saved frame the branch was copied from */
+      int            end;        /* the frame state is at, or NullFrame if it failed */
+      int            target;     /* the frame the worker is running it to */
+      ggpo::byte     *state;
+      int            cstate;
+      ggpo::byte     *keyframes; /* keyframe n is saved at slot (n / interval) % count, like _savedstate */
+      ggpo::byte     *inputs;    /* inputs for frame n, starting with start */
+      int            *disconnect_flags;
    };
    struct SavedState {
-      SavedFrame frames[MAX_PREDICTION_FRAMES + 2];
+      SavedFrame *frames;     /* keyframe n is saved in frames[(n / interval) % count] */
+      int count;
       int head;
+      GGPOSnapshotMode mode;
+      ggpo::byte *arena;      /* frames[i].buf point into here when in use */
+      int arena_slot_size;
+      ggpo::byte *latest;     /* delta mode: the last saved frame, in full */
+      int latest_capacity;
+      ggpo::byte *scratch;    /* delta mode: where save_game_state_into writes */
+      PageSnapshots *pages;   /* page mode: tracks the client's state region */
    };
 
    void LoadFrame(int frame);
    void SaveCurrentFrame();
+   void SaveArenaFrame(SavedFrame *state);
+   void WaitForSave();
+   static void RunBackgroundSave(void *context);
+   void SaveDeltaFrame(SavedFrame *state);
+   void RebuildDeltaFrame(int index);
+   void SavePageFrame(SavedFrame *state);
+   void RebuildPageFrame(int index);
+   void AllocateSavedFrames();
+   void AllocateSnapshots();
+   bool AllocateBranches();
+   void FreeBranches();
    int FindSavedFrameIndex(int frame);
    SavedFrame &GetLastSavedFrame();
 
    bool CreateQueues(Config &config);
    bool CheckSimulationConsistency(int *seekTo);
+   void DeferRollback(int seek_to);
+   void RunPendingRollback();
+   void CatchUp();
+   void Speculate();
+   bool PeekFrameInputs(int frame, Branch *branch);
+   bool UseBranch(int seek_to);
+   void DiscardBranches();
+   static void RunBranch(void *context);
+   int GetIncorrectInputCount();
    void ResetPrediction(int frameNumber);
+   int GetFrameInputs(int frame, void *values, int size);
 
 protected:
    GGPOSessionCallbacks _callbacks;
    SavedState     _savedstate;
+   GGPOSnapshotStats _snapshot_stats;
    Config         _config;
 
    bool           _rollingback;
    int            _last_confirmed_frame;
    int            _framecount;
    int            _max_prediction_frames;
+   int            _keyframe_interval;
+
+   bool           _coalesce_rollbacks;
+   int            _pending_rollback_frame;
+   int            _pending_incorrect_inputs;
+
+   int            _rollback_budget;       /* microseconds per frame, or 0 */
+   ggpo::uint32   _rollback_time_spent;
+   int            _catchup_frame;         /* where an unfinished rollback is headed */
+
+   SnapshotWorker *_save_worker;          /* NULL unless background saves are on */
+   int            _pending_save;          /* slot being saved by the worker, or -1 */
+
+   Branch         *_branches;
+   int            _num_branches;
+   int            _branch_capacity;       /* frames of input each branch can hold */
+   ggpo::byte     *_branch_inputs;        /* the real inputs, for checking branches */
+   int            *_branch_flags;
 
    InputQueue     *_input_queues;
 
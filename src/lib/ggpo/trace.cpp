@@ -0,0 +1,194 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#include <atomic>
+#include <map>
+#include <vector>
+#include "trace.h"
+
+/*
+ * Only the owning thread writes to a ring.  count is bumped after each
+ * record is filled in, so TraceDump can tell which records it copied
+ * were complete.  Rings are never freed, so the last records of a thread
+ * which has exited still make it into the dump.
+ */
+struct TraceRing {
+   TraceRing                  *next;
+   int                        thread;
+   std::atomic<ggpo::uint32>  count;      /* records ever written */
+   TraceRecord                records[TRACE_RING_LENGTH];
+};
+
+static std::atomic<TraceRing *> trace_rings(NULL);
+static std::atomic<int> trace_threads(0);
+static thread_local TraceRing *trace_ring = NULL;
+
+static TraceRing *
+TraceGetRing()
+{
+   TraceRing *ring = trace_ring;
+   if (!ring) {
+      ring = new TraceRing;
+      ring->thread = trace_threads.fetch_add(1);
+      ring->count.store(0, std::memory_order_relaxed);
+      ring->next = trace_rings.load(std::memory_order_relaxed);
+      while (!trace_rings.compare_exchange_weak(ring->next, ring, std::memory_order_release, std::memory_order_relaxed)) {
+      }
+      trace_ring = ring;
+   }
+   return ring;
+}
+
+void
+TraceRecordv(const char *prefix, int id, const char *fmt, va_list args)
+{
+   TraceRing *ring = TraceGetRing();
+   ggpo::uint32 n = ring->count.load(std::memory_order_relaxed);
+   TraceRecord *record = ring->records + (n % TRACE_RING_LENGTH);
+
+   record->fmt = (ggpo::uint64)(size_t)fmt;
+   record->prefix = (ggpo::uint64)(size_t)prefix;
+   record->time = Platform::GetCurrentTimeUS();
+   record->id = id;
+   record->nargs = 0;
+
+   /*
+    * Copy arguments until one doesn't fit.  ggpotrace prints whatever
+    * is missing as "?".
+    */
+   ggpo::byte *p = record->args;
+   ggpo::byte *limit = record->args + sizeof(record->args);
+   const char *spec, *end;
+   for (;;) {
+      TraceArg arg = TraceNextArg(fmt, &spec, &end);
+      if (arg == TRACE_ARG_NONE || arg == TRACE_ARG_UNSUPPORTED) {
+         break;
+      }
+      fmt = end;
+
+      if (arg == TRACE_ARG_STRING) {
+         const char *s = va_arg(args, const char *);
+         int len = 0;
+         int room = MIN((int)(limit - p) - 1, 255);
+         if (room < 0) {
+            break;
+         }
+         while (s && len < room && s[len]) {
+            len++;
+         }
+         *p++ = (ggpo::byte)len;
+         memcpy(p, s, len);
+         p += len;
+      } else {
+         ggpo::uint64 value;
+         if (limit - p < (int)sizeof(value)) {
+            break;
+         }
+         switch (arg) {
+         case TRACE_ARG_INT:
+            value = (ggpo::uint64)va_arg(args, int);
+            break;
+         case TRACE_ARG_INT64:
+            value = (ggpo::uint64)va_arg(args, long long);
+            break;
+         case TRACE_ARG_DOUBLE: {
+            double d = va_arg(args, double);
+            memcpy(&value, &d, sizeof(value));
+            break;
+         }
+         default:
+            value = (ggpo::uint64)(size_t)va_arg(args, void *);
+            break;
+         }
+         memcpy(p, &value, sizeof(value));
+         p += sizeof(value);
+      }
+      record->nargs++;
+   }
+
+   ring->count.store(n + 1, std::memory_order_release);
+}
+
+static void
+TraceAddString(std::map<ggpo::uint64, const char *> &strings, ggpo::uint64 address)
+{
+   if (address) {
+      strings[address] = (const char *)(size_t)address;
+   }
+}
+
+void
+TraceDump()
+{
+   struct Copy {
+      int                        thread;
+      std::vector<TraceRecord>   records;
+   };
+   std::vector<Copy> copies;
+   std::map<ggpo::uint64, const char *> strings;
+
+   for (TraceRing *ring = trace_rings.load(std::memory_order_acquire); ring; ring = ring->next) {
+      Copy copy;
+      ggpo::uint32 count = ring->count.load(std::memory_order_acquire);
+      ggpo::uint32 first = count > TRACE_RING_LENGTH ? count - TRACE_RING_LENGTH : 0;
+
+      copy.thread = ring->thread;
+      for (ggpo::uint32 i = first; i < count; i++) {
+         copy.records.push_back(ring->records[i % TRACE_RING_LENGTH]);
+      }
+
+      /*
+       * If the thread kept logging while we copied, the oldest records
+       * may have been overwritten underneath us.  Throw those away.
+       */
+      ggpo::uint32 now = ring->count.load(std::memory_order_acquire);
+      if (now >= TRACE_RING_LENGTH && now - TRACE_RING_LENGTH + 1 > first) {
+         ggpo::uint32 stale = MIN(now - TRACE_RING_LENGTH + 1 - first, (ggpo::uint32)copy.records.size());
+         copy.records.erase(copy.records.begin(), copy.records.begin() + stale);
+      }
+
+      for (size_t i = 0; i < copy.records.size(); i++) {
+         TraceAddString(strings, copy.records[i].fmt);
+         TraceAddString(strings, copy.records[i].prefix);
+      }
+      copies.push_back(copy);
+   }
+
+   char filename[64];
+   FILE *fp = NULL;
+   sprintf_s(filename, ARRAY_SIZE(filename), "trace-%d.bin", Platform::GetProcessID());
+   fopen_s(&fp, filename, "wb");
+   if (!fp) {
+      return;
+   }
+
+   TraceFileHeader header;
+   header.magic = TRACE_FILE_MAGIC;
+   header.version = TRACE_FILE_VERSION;
+   header.record_size = sizeof(TraceRecord);
+   header.num_strings = (ggpo::uint32)strings.size();
+   header.num_rings = (ggpo::uint32)copies.size();
+   fwrite(&header, sizeof(header), 1, fp);
+
+   for (std::map<ggpo::uint64, const char *>::iterator i = strings.begin(); i != strings.end(); i++) {
+      ggpo::uint32 len = (ggpo::uint32)strlen(i->second);
+      fwrite(&i->first, sizeof(i->first), 1, fp);
+      fwrite(&len, sizeof(len), 1, fp);
+      fwrite(i->second, 1, len, fp);
+   }
+
+   for (size_t i = 0; i < copies.size(); i++) {
+      ggpo::uint32 thread = copies[i].thread;
+      ggpo::uint32 count = (ggpo::uint32)copies[i].records.size();
+      fwrite(&thread, sizeof(thread), 1, fp);
+      fwrite(&count, sizeof(count), 1, fp);
+      if (count) {
+         fwrite(&copies[i].records[0], sizeof(TraceRecord), count, fp);
+      }
+   }
+   fclose(fp);
+}
@@ -0,0 +1,132 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <string.h>
+#include "types.h"
+
+/*
+ * Binary tracing.  With ggpo.log.trace set, a log message costs a copy of
+ * its format string's address and its raw arguments into a ring owned by
+ * the calling thread.  Nothing is formatted and nothing is written until
+ * TraceDump, which saves every ring to trace-<pid>.bin along with the
+ * format strings they point to.  The ggpotrace tool turns that file back
+ * into the text the log would have had.
+ */
+
+#ifndef TRACE_RING_LENGTH
+#define TRACE_RING_LENGTH        8192      /* records kept per thread */
+#endif
+#define TRACE_RECORD_SIZE        128
+
+#define TRACE_FILE_MAGIC         0x43525447   /* "GTRC" */
+#define TRACE_FILE_VERSION       1
+
+enum TraceArg {
+   TRACE_ARG_NONE,
+   TRACE_ARG_INT,                /* int-sized integers, and %c */
+   TRACE_ARG_INT64,              /* %lld, %I64d, %zd and friends */
+   TRACE_ARG_DOUBLE,
+   TRACE_ARG_STRING,             /* a length byte and that many chars, cut short to fit */
+   TRACE_ARG_POINTER,
+   TRACE_ARG_UNSUPPORTED,        /* %* and %n.  Capture stops here. */
+};
+
+struct TraceRecord {
+   ggpo::uint64      fmt;        /* the address of the format string */
+   ggpo::uint64      prefix;     /* a class's "name%d | " format, or 0 */
+   ggpo::uint32      time;       /* Platform::GetCurrentTimeUS */
+   int               id;         /* the argument to prefix */
+   ggpo::uint8       nargs;      /* how many of fmt's arguments fit */
+   ggpo::byte        args[TRACE_RECORD_SIZE - 25];
+};
+
+/*
+ * A trace file is a TraceFileHeader, then num_strings of
+ * { uint64 address, uint32 length, chars }, then num_rings of
+ * { uint32 thread, uint32 count, TraceRecord[count] }, oldest first.
+ */
+struct TraceFileHeader {
+   ggpo::uint32      magic;
+   ggpo::uint32      version;
+   ggpo::uint32      record_size;
+   ggpo::uint32      num_strings;
+   ggpo::uint32      num_rings;
+};
+
+/*
+ * Finds the next conversion in a printf format.  Returns what kind of
+ * argument it takes and points *spec at the '%' and *end just past the
+ * conversion, or TRACE_ARG_NONE at the end of the string.  Used both to
+ * pull arguments off the va_list and, in ggpotrace, to put them back.
+ */
+inline TraceArg
+TraceNextArg(const char *fmt, const char **spec, const char **end)
+{
+   for (;;) {
+      while (*fmt && *fmt != '%') {
+         fmt++;
+      }
+      if (!*fmt) {
+         *spec = *end = fmt;
+         return TRACE_ARG_NONE;
+      }
+      if (fmt[1] == '%') {
+         fmt += 2;
+         continue;
+      }
+      break;
+   }
+
+   const char *p = fmt + 1;
+   bool wide = false;
+   while (*p && strchr("-+ #0123456789.", *p)) {
+      p++;
+   }
+   if (*p == '*') {
+      *spec = fmt;
+      *end = p + 1;
+      return TRACE_ARG_UNSUPPORTED;
+   }
+   for (;;) {
+      if (*p == 'l' && p[1] == 'l') {
+         wide = true;
+         p += 2;
+      } else if (*p == 'I' && p[1] == '6' && p[2] == '4') {
+         wide = true;
+         p += 3;
+      } else if (*p == 'z' || *p == 'j' || *p == 't') {
+         wide = sizeof(size_t) == 8;
+         p++;
+      } else if (*p == 'h' || *p == 'l' || *p == 'L') {
+         p++;
+      } else {
+         break;
+      }
+   }
+
+   *spec = fmt;
+   *end = *p ? p + 1 : p;
+   switch (*p) {
+   case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'c':
+      return wide ? TRACE_ARG_INT64 : TRACE_ARG_INT;
+   case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+      return TRACE_ARG_DOUBLE;
+   case 's':
+      return TRACE_ARG_STRING;
+   case 'p':
+      return TRACE_ARG_POINTER;
+   }
+   return TRACE_ARG_UNSUPPORTED;
+}
+
+extern void TraceRecordv(const char *prefix, int id, const char *fmt, va_list args);
+extern void TraceDump();
+
+#endif
@@ -29,6 +29,7 @@ namespace ggpo {
     typedef unsigned char uint8;
     typedef unsigned short uint16;
     typedef unsigned int uint32;
+    typedef unsigned long long uint64;
     typedef unsigned char byte;
     typedef char int8;
     typedef short int16;
@@ -58,10 +59,10 @@ namespace ggpo {
       if (!(x)) {                                           \
          char assert_buf[1024];                             \
          snprintf(assert_buf, sizeof(assert_buf) - 1, "Assertion: %s @ %s:%d (pid:%d)", #x, __FILE__, __LINE__, Platform::GetProcessID()); \
-         Log("%s\n", assert_buf);                           \
-         Log("\n");                                         \
-         Log("\n");                                         \
-         Log("\n");                                         \
+         LogError("%s\n", assert_buf);                      \
+         LogError("\n");                                    \
+         LogError("\n");                                    \
+         LogError("\n");                                    \
          Platform::AssertFailed(assert_buf);                \
          exit(0);                                           \
       }                                                     \
@@ -0,0 +1,62 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+#ifndef _VARINT_H
+#define _VARINT_H
+
+#include "types.h"
+
+/*
+ * Variable length integers: 7 bits to a byte, low bits first, with the
+ * top bit set on every byte but the last.  Numbers under 128 take one
+ * byte.  Signed numbers go through Varint_ZigZag first so that small
+ * negative ones stay small too.
+ */
+
+#define VARINT_MAX_BYTES      5
+
+inline ggpo::uint32
+Varint_ZigZag(int value)
+{
+   return ((ggpo::uint32)value << 1) ^ (ggpo::uint32)(value >> 31);
+}
+
+inline int
+Varint_UnZigZag(ggpo::uint32 value)
+{
+   return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+inline void
+Varint_Write(ggpo::uint8 *buffer, int *offset, ggpo::uint32 value)
+{
+   while (value >= 0x80) {
+      buffer[(*offset)++] = (ggpo::uint8)(value | 0x80);
+      value >>= 7;
+   }
+   buffer[(*offset)++] = (ggpo::uint8)value;
+}
+
+/*
+ * Returns false if the number runs past len or is too long to be one.
+ */
+inline bool
+Varint_Read(const ggpo::uint8 *buffer, int len, int *offset, ggpo::uint32 *value)
+{
+   ggpo::uint32 result = 0;
+   for (int i = 0; i < VARINT_MAX_BYTES && *offset < len; i++) {
+      ggpo::uint8 b = buffer[(*offset)++];
+      result |= (ggpo::uint32)(b & 0x7f) << (7 * i);
+      if (!(b & 0x80)) {
+         *value = result;
+         return true;
+      }
+   }
+   return false;
+}
+
+#endif
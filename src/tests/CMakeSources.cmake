@@ -0,0 +1,44 @@
+set(GGPO_TESTS_SRC_NOFILTER
+	"input_queue_bench.cpp"
+	"steam_pending_output_test.cpp"
+)
+
+source_group(" " FILES ${GGPO_TESTS_SRC_NOFILTER})
+
+# Classes aren't exported from the library, so the tests build the parts
+# of it they use themselves.
+if(WIN32)
+	set(GGPO_TESTS_PLATFORM_SRC "${CMAKE_SOURCE_DIR}/src/lib/ggpo/platform_windows.cpp")
+	set(GGPO_TESTS_RECEIVE_THREAD_SRC "${CMAKE_SOURCE_DIR}/src/lib/ggpo/network/receive_thread_windows.cpp")
+else()
+	set(GGPO_TESTS_PLATFORM_SRC "${CMAKE_SOURCE_DIR}/src/lib/ggpo/platform_linux.cpp")
+	set(GGPO_TESTS_RECEIVE_THREAD_SRC "${CMAKE_SOURCE_DIR}/src/lib/ggpo/network/receive_thread_linux.cpp")
+endif()
+
+set(GGPO_TESTS_LIB_SRC
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/bitvector.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/bytemask.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/config.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/game_input.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/log.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/poll.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/timesync.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/trace.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/network/steam.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/network/steam_proto.cpp"
+	${GGPO_TESTS_RECEIVE_THREAD_SRC}
+	${GGPO_TESTS_PLATFORM_SRC}
+)
+
+set(GGPO_TESTS_QUEUE_SRC
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/checksum.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/config.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/game_input.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/input_predictor.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/input_queue.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/log.cpp"
+	"${CMAKE_SOURCE_DIR}/src/lib/ggpo/trace.cpp"
+	${GGPO_TESTS_PLATFORM_SRC}
+)
+
+source_group("lib" FILES ${GGPO_TESTS_LIB_SRC} ${GGPO_TESTS_QUEUE_SRC})
@@ -0,0 +1,68 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+/*
+ * Times InputQueue::AddInput and GetInput on confirmed frames, which every
+ * player's queue goes through on every frame of a session.  Logging is off
+ * unless ggpo.log is set, so the time is what the disabled log calls cost.
+ * input_queue_bench_nolog is the same thing built with GGPO_LOG_LEVEL=0,
+ * so comparing the two shows what's left of logging when it's off.
+ *
+ *    input_queue_bench [frames]
+ */
+
+#include "types.h"
+#include "input_queue.h"
+
+#define BENCH_DEFAULT_FRAMES  2000000
+#define BENCH_RUNS            5
+#define BENCH_INPUT_SIZE      4
+
+static int
+RunFrames(int frames)
+{
+   InputQueue queue;
+   int checksum = 0;
+
+   queue.Init(0, BENCH_INPUT_SIZE);
+   for (int frame = 0; frame < frames; frame++) {
+      GameInput input, output;
+      ggpo::uint32 value = (ggpo::uint32)(frame / 16) * 2654435761u;
+      input.init(frame, (char *)&value, BENCH_INPUT_SIZE);
+      queue.AddInput(input);
+      queue.GetInput(frame, &output);
+      checksum += output.bits[0];
+      if (frame % 32 == 31) {
+         queue.DiscardConfirmedFrames(frame - 1);
+      }
+   }
+   return checksum;
+}
+
+int
+main(int argc, char *argv[])
+{
+   int frames = argc > 1 ? atoi(argv[1]) : BENCH_DEFAULT_FRAMES;
+   ggpo::uint32 best = 0;
+   int checksum = 0;
+
+   if (frames <= 0) {
+      printf("usage: %s [frames]\n", argv[0]);
+      return 1;
+   }
+   for (int i = 0; i < BENCH_RUNS; i++) {
+      ggpo::uint32 start = Platform::GetCurrentTimeUS();
+      checksum += RunFrames(frames);
+      ggpo::uint32 elapsed = Platform::GetCurrentTimeUS() - start;
+      if (!i || elapsed < best) {
+         best = elapsed;
+      }
+   }
+   printf("GGPO_LOG_LEVEL %d, runtime log level %d: %d frames, best of %d runs %.1f ns/frame (%d)\n",
+          GGPO_LOG_LEVEL, LogGetLevel(), frames, BENCH_RUNS, best * 1000.0 / frames, checksum);
+   return 0;
+}
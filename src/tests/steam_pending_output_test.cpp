@@ -0,0 +1,230 @@
+/* -----------------------------------------------------------------------
+ * GGPO.net (http://ggpo.net)  -  Copyright 2009 GroundStorm Studios, LLC.
+ *
+ * Use of this software is governed by the MIT license that can be found
+ * in the LICENSE file.
+ */
+
+/*
+ * Fills a SteamProtocol's pending output with inputs which change every
+ * frame, more than one message can hold, and checks that each codec stops
+ * at the end of the message's storage and that what it did write decodes
+ * back to the inputs that went in.  Also checks a single frame where every
+ * bit changed takes no more than each codec's worst case says, and that a
+ * CompactInput's connect status comes back out the way it went in.
+ */
+
+#include "types.h"
+#include "bitvector.h"
+#include "bytemask.h"
+#include "steam_proto.h"
+
+#define GUARD_BYTES     64
+#define GUARD_VALUE     0xcd
+
+class PendingOutputTest : public SteamProtocol
+{
+public:
+   bool Run(SteamMsg::InputCodec codec, int size);
+   bool RunWorstCase(SteamMsg::InputCodec codec, int size);
+   bool RunCompactStatus(int num_bits);
+
+protected:
+   int Decode(SteamMsg::InputCodec codec, SteamMsg *msg, int num_bits, int size, char frames[][GameInput::Capacity]);
+};
+
+/*
+ * Decodes up to the whole pending window from msg into frames, and
+ * returns how many there were.
+ */
+int
+PendingOutputTest::Decode(SteamMsg::InputCodec codec, SteamMsg *msg, int num_bits, int size, char frames[][GameInput::Capacity])
+{
+   char current[GameInput::Capacity] = { 0 };
+   int count = 0;
+
+   if (codec == SteamMsg::ByteMaskCodec) {
+      ByteMaskReader reader;
+      if (!ByteMask_BeginRead(&reader, msg->u.input.bits, num_bits / 8, size)) {
+         return 0;
+      }
+      while (count < _pending_output.size() && ByteMask_ReadFrame(&reader, current)) {
+         memcpy(frames[count++], current, size);
+      }
+      return count;
+   }
+
+   int offset = 0;
+   while (offset < num_bits && count < _pending_output.size()) {
+      while (BitVector_ReadBit(msg->u.input.bits, &offset)) {
+         int on = BitVector_ReadBit(msg->u.input.bits, &offset);
+         int button = BitVector_ReadNibblet(msg->u.input.bits, &offset);
+         if (on) {
+            current[button / 8] |= 1 << (button % 8);
+         } else {
+            current[button / 8] &= ~(1 << (button % 8));
+         }
+      }
+      memcpy(frames[count++], current, size);
+   }
+   return count;
+}
+
+bool
+PendingOutputTest::Run(SteamMsg::InputCodec codec, int size)
+{
+   const char *name = codec == SteamMsg::ByteMaskCodec ? "byte mask" : "bit";
+   ggpo::uint64 buffer[(STEAM_MSG_MAX_SIZE + GUARD_BYTES) / sizeof(ggpo::uint64) + 1];
+   char frames[64][GameInput::Capacity];
+   int i, j, num_bits, sent;
+
+   if (codec == SteamMsg::BitCodec && BITVECTOR_MAX_FRAME_BITS(size) > STEAM_MSG_MAX_INPUT_BITS) {
+      printf("%s codec, %d byte inputs: skipped, a frame may not fit so it's never used.\n", name, size);
+      return true;
+   }
+   _input_codec = codec;
+   while (!_pending_output.empty()) {
+      _pending_output.pop();
+   }
+   for (j = 0; _pending_output.size() < 63; j++) {
+      char bits[GameInput::Capacity];
+      for (i = 0; i < size; i++) {
+         bits[i] = (char)((j + 1) * (i + 1) + i);
+      }
+      GameInput input;
+      input.init(j, bits, size);
+      _pending_output.push(input);
+   }
+
+   memset(buffer, GUARD_VALUE, sizeof(buffer));
+   SteamMsg *msg = (SteamMsg *)buffer;
+   if (codec == SteamMsg::ByteMaskCodec) {
+      num_bits = EncodeByteMaskInputs(msg, STEAM_MSG_MAX_INPUT_BITS, &sent);
+   } else {
+      num_bits = EncodeBitInputs(msg, STEAM_MSG_MAX_INPUT_BITS, &sent);
+   }
+
+   for (i = STEAM_MSG_MAX_SIZE; i < (int)sizeof(buffer); i++) {
+      if (((ggpo::uint8 *)buffer)[i] != GUARD_VALUE) {
+         printf("%s codec, %d byte inputs: wrote past the end of the message.\n", name, size);
+         return false;
+      }
+   }
+   if (num_bits > STEAM_MSG_MAX_INPUT_BITS) {
+      printf("%s codec, %d byte inputs: %d bits is more than a message holds.\n", name, size, num_bits);
+      return false;
+   }
+   if (sent < 1 || sent >= _pending_output.size()) {
+      printf("%s codec, %d byte inputs: sent %d of %d frames, expected some but not all.\n", name, size, sent, _pending_output.size());
+      return false;
+   }
+   if (Decode(codec, msg, num_bits, size, frames) != sent) {
+      printf("%s codec, %d byte inputs: decoded a different number of frames than the %d sent.\n", name, size, sent);
+      return false;
+   }
+   for (j = 0; j < sent; j++) {
+      if (memcmp(frames[j], _pending_output.item(j).bits, size)) {
+         printf("%s codec, %d byte inputs: frame %d decoded wrong.\n", name, size, j);
+         return false;
+      }
+   }
+   printf("%s codec, %d byte inputs: sent %d of %d frames in %d bytes.\n", name, size, sent, _pending_output.size(), (num_bits + 7) / 8);
+   return true;
+}
+
+bool
+PendingOutputTest::RunWorstCase(SteamMsg::InputCodec codec, int size)
+{
+   const char *name = codec == SteamMsg::ByteMaskCodec ? "byte mask" : "bit";
+   ggpo::uint64 buffer[STEAM_MSG_MAX_SIZE / sizeof(ggpo::uint64) + 1];
+   char bits[GameInput::Capacity];
+   int num_bits, sent, worst;
+
+   _input_codec = codec;
+   while (!_pending_output.empty()) {
+      _pending_output.pop();
+   }
+   memset(bits, 0xff, sizeof(bits));
+   GameInput input;
+   input.init(0, bits, size);
+   _pending_output.push(input);
+
+   SteamMsg *msg = (SteamMsg *)buffer;
+   if (codec == SteamMsg::ByteMaskCodec) {
+      num_bits = EncodeByteMaskInputs(msg, STEAM_MSG_MAX_INPUT_BITS, &sent);
+      worst = BYTEMASK_MAX_FRAME_SIZE(size) * 8;
+   } else {
+      num_bits = EncodeBitInputs(msg, STEAM_MSG_MAX_INPUT_BITS, &sent);
+      worst = BITVECTOR_MAX_FRAME_BITS(size);
+   }
+   if (worst <= STEAM_MSG_MAX_INPUT_BITS && sent != 1) {
+      printf("%s codec, %d byte inputs: a changed frame should fit in %d bits, but didn't.\n", name, size, worst);
+      return false;
+   }
+   if (sent && num_bits > worst) {
+      printf("%s codec, %d byte inputs: a changed frame took %d bits, more than the %d expected.\n", name, size, num_bits, worst);
+      return false;
+   }
+   printf("%s codec, %d byte inputs: a changed frame took %d bits, at most %d.\n", name, size, num_bits, worst);
+   return true;
+}
+
+bool
+PendingOutputTest::RunCompactStatus(int num_bits)
+{
+   static const SteamMsg::connect_status status[STEAM_MSG_MAX_PLAYERS] = {
+      { 0, 1000 }, { 1, 990 }, { 0, 20000 }, { 0, -1 }
+   };
+   int i, len;
+
+   _msg_pool.init();
+   _input_size = _peer_input_size = 1;
+
+   SteamMsg *msg = _msg_pool.alloc(SteamMsg::Input);
+   memcpy(msg->u.input.peer_connect_status, status, sizeof(status));
+   msg->u.input.disconnect_requested = 0;
+   msg->u.input.ack_frame = 995;
+   msg->u.input.start_frame = num_bits ? 1001 : 0;
+   msg->u.input.num_bits = (ggpo::uint16)num_bits;
+   msg->u.input.input_size = num_bits ? 1 : 0;
+   memset(msg->u.input.bits, 0x5a, (num_bits + 7) / 8);
+
+   SteamMsg *packed = PackInput(msg);
+   SteamMsg *unpacked = UnpackInput(packed, packed->PacketSize(), &len);
+   if (!unpacked) {
+      printf("compact input, %d bits: couldn't unpack it.\n", num_bits);
+      return false;
+   }
+   bool ok = unpacked->u.input.ack_frame == 995 &&
+             unpacked->u.input.num_bits == num_bits &&
+             (!num_bits || unpacked->u.input.start_frame == 1001);
+   for (i = 0; i < STEAM_MSG_MAX_PLAYERS; i++) {
+      ok = ok && unpacked->u.input.peer_connect_status[i].disconnected == status[i].disconnected &&
+           unpacked->u.input.peer_connect_status[i].last_frame == status[i].last_frame;
+   }
+   if (!ok) {
+      printf("compact input, %d bits: unpacked wrong.\n", num_bits);
+   } else {
+      printf("compact input, %d bits: %d bytes.\n", num_bits, packed->PacketSize());
+   }
+   _msg_pool.release(packed);
+   _msg_pool.release(unpacked);
+   return ok;
+}
+
+int
+main(int argc, char *argv[])
+{
+   static PendingOutputTest test;
+   bool ok = true;
+
+   ok = test.Run(SteamMsg::BitCodec, GAMEINPUT_MAX_BYTES) && ok;
+   ok = test.Run(SteamMsg::BitCodec, GameInput::Capacity) && ok;
+   ok = test.Run(SteamMsg::ByteMaskCodec, GAMEINPUT_MAX_BYTES) && ok;
+   ok = test.Run(SteamMsg::ByteMaskCodec, GameInput::Capacity) && ok;
+   ok = test.RunWorstCase(SteamMsg::BitCodec, GameInput::Capacity) && ok;
+   ok = test.RunWorstCase(SteamMsg::ByteMaskCodec, GameInput::Capacity) && ok;
+   ok = test.RunCompactStatus(0) && ok;
+   ok = test.RunCompactStatus(8) && ok;
+   return ok ? 0 : 1;
+}